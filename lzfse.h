@@ -22,10 +22,9 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #ifndef LZFSE_H
 #define LZFSE_H
 
-#include <linux/stddef.h>
-#include <linux/types.h>
-
+#include "lzfse_compat.h"
 #include "lzvn.h"
+
 /*! @abstract Get the required scratch buffer size to compress using LZFSE.   */
 size_t lzfse_encode_scratch_size(void);
 
@@ -64,6 +63,14 @@ size_t lzfse_encode_buffer(uint8_t *dst_buffer,
                                      size_t src_size,
                                      void *scratch_buffer);
 
+/*! @abstract Same as lzfse_encode_buffer, with inputs that are encoded as a
+ *  single LZVN block (smaller than LZFSE_ENCODE_LZVN_THRESHOLD) compressed at
+ *  \p lzvn_level, one of the LZVN_ENCODE_LEVEL_* values. Larger inputs are
+ *  not affected. */
+size_t lzfse_encode_buffer_level(uint8_t *dst_buffer, size_t dst_size,
+                                 const uint8_t *src_buffer, size_t src_size,
+                                 void *scratch_buffer, int lzvn_level);
+
 /*! @abstract Get the required scratch buffer size to decompress using LZFSE. */
 size_t lzfse_decode_scratch_size(void);
 
@@ -103,6 +110,296 @@ size_t lzfse_decode_buffer(uint8_t *dst_buffer,
                                      size_t src_size,
                                      void *scratch_buffer);
 
+/*! @abstract Prepare a scratch buffer of lzfse_decode_scratch_size( ) bytes
+ *  to be used as a reusable decoder context by lzfse_decode_buffer_cached( ). */
+void lzfse_decode_scratch_init(void *scratch_buffer);
+
+/*! @abstract Decompress a buffer using LZFSE, reusing decoder tables cached
+ *  in the scratch buffer by previous calls.
+ *
+ *  Identical to lzfse_decode_buffer( ), except that \p scratch_buffer is a
+ *  decoder context that must have been prepared once with
+ *  lzfse_decode_scratch_init( ), and is not cleared between calls. Blocks
+ *  whose frequency tables match those of the previously decoded block skip
+ *  the decoder table setup, which helps streams made of many small blocks.
+ *  A context must not be used by several callers concurrently.               */
+size_t lzfse_decode_buffer_cached(uint8_t *dst_buffer,
+                                  size_t dst_size,
+                                  const uint8_t *src_buffer,
+                                  size_t src_size,
+                                  void *scratch_buffer);
+
+/*! @abstract Decompress a buffer using LZFSE, trusting the source to be a
+ *  well formed stream (for example, one produced by lzfse_encode_buffer( )
+ *  and verified with a checksum by the caller).
+ *
+ *  Identical to lzfse_decode_buffer( ), except that LZFSE blocks with enough
+ *  destination space for their declared n_raw_bytes are decoded by a loop
+ *  which only checks literal, match and payload bounds once per block
+ *  instead of once per match. A corrupt source is still reported as an
+ *  error, but only after the whole block has been decoded, and may read or
+ *  write out of bounds before that. Never use this on untrusted input.      */
+size_t lzfse_decode_buffer_trusted(uint8_t *dst_buffer,
+                                   size_t dst_size,
+                                   const uint8_t *src_buffer,
+                                   size_t src_size,
+                                   void *scratch_buffer);
+
+/*! @abstract Get the decompressed size of an LZFSE stream, by adding up the
+ *  n_raw_bytes of its block headers. No payload is decoded.
+ *
+ *  @return
+ *  The number of bytes lzfse_decode_buffer( ) would produce for the stream,
+ *  or zero if the stream is empty, malformed, or truncated before its end of
+ *  stream block.                                                             */
+size_t lzfse_decoded_size(const uint8_t *src_buffer, size_t src_size);
+
+/*! @abstract Get the safety margin needed to decompress an LZFSE stream in
+ *  place with lzfse_decode_buffer_inplace( ).
+ *
+ *  The margin accounts, for each block, for the source bytes that are still
+ *  unread while the block is being written: the whole payload of LZVN blocks,
+ *  the L, M, D payload of LZFSE blocks (their literals are staged in the
+ *  scratch buffer when the block starts), and nothing for uncompressed blocks,
+ *  which are moved with memmove.
+ *
+ *  @return
+ *  The number of bytes the in-place buffer needs beyond the decompressed
+ *  size, or zero if the stream is malformed or truncated.                    */
+size_t lzfse_decode_inplace_margin(const uint8_t *src_buffer, size_t src_size);
+
+/*! @abstract Decompress an LZFSE stream in place.
+ *
+ *  @param buffer
+ *  Buffer holding the compressed stream in its last \p src_size bytes, and
+ *  receiving the decompressed data from its first byte.
+ *
+ *  @param buffer_size
+ *  Size of \p buffer in bytes. It must be at least the decompressed size plus
+ *  lzfse_decode_inplace_margin( ); otherwise nothing is decoded.
+ *
+ *  @param src_size
+ *  Size of the compressed stream at the end of \p buffer.
+ *
+ *  @param scratch_buffer
+ *  A pointer to lzfse_decode_scratch_size( ) bytes of workspace, outside of
+ *  \p buffer.
+ *
+ *  @return
+ *  The number of decompressed bytes at the start of \p buffer, or zero on
+ *  failure, in which case the contents of \p buffer are unspecified.        */
+size_t lzfse_decode_buffer_inplace(uint8_t *buffer, size_t buffer_size,
+                                   size_t src_size, void *scratch_buffer);
+
+/*! @abstract Check an LZFSE stream without decompressing it.
+ *
+ *  Runs the same header checks and bitstream decoding as
+ *  lzfse_decode_buffer( ), and checks literal and match lengths and match
+ *  distances, but never writes output: uncompressed blocks are skipped, and
+ *  only the number of decoded bytes is tracked. In addition, each compressed
+ *  block must produce exactly the number of bytes declared in its header.
+ *
+ *  @param scratch_buffer
+ *  A pointer to lzfse_decode_scratch_size( ) bytes of workspace.
+ *
+ *  @return
+ *  The decompressed size of the stream if it is valid and complete, or zero
+ *  otherwise.                                                                */
+size_t lzfse_validate_buffer(const uint8_t *src_buffer, size_t src_size,
+                             void *scratch_buffer);
+
+/*! @abstract Decompress only bytes [offset, offset + length) of an LZFSE
+ *  stream.
+ *
+ *  Leading blocks are skipped without being decoded when no block decoded
+ *  afterwards can reference their output: LZFSE and LZVN blocks need up to
+ *  LZFSE_ENCODE_MAX_D_VALUE bytes of history before them, uncompressed blocks
+ *  need none. Decoding stops exactly at offset + length.
+ *
+ *  @param dst_buffer
+ *  Destination buffer of at least offset + length bytes. On return, the
+ *  requested range is at dst_buffer + offset; the bytes before it are used as
+ *  history and their contents are unspecified.
+ *
+ *  @param scratch_buffer
+ *  A pointer to lzfse_decode_scratch_size( ) bytes of workspace.
+ *
+ *  @return
+ *  The number of bytes decoded in the range, which is less than \p length if
+ *  the stream ends before offset + length, or zero on failure.              */
+size_t lzfse_decode_range(uint8_t *dst_buffer, size_t offset, size_t length,
+                          const uint8_t *src_buffer, size_t src_size,
+                          void *scratch_buffer);
+
+/*! @abstract Get the required scratch buffer size to compress a page with
+ *  lzfse_compress_page. */
+size_t lzfse_page_scratch_size(void);
+
+/*! @abstract Compress exactly LZVN_PAGE_SIZE bytes (the kernel page size)
+ *  from \p page.
+ *
+ *  Pages filled with a single byte value, including zero pages, are detected
+ *  and stored in a few dozen bytes. Other pages are encoded as one LZVN block
+ *  using a small fixed table in \p scratch_buffer. Compression gives up as
+ *  soon as the output would not fit in \p dst_size bytes, so a caller that
+ *  only keeps results smaller than some limit should pass that limit. If
+ *  LZVN cannot reach \p dst_size but the page fits uncompressed, an
+ *  uncompressed block is stored.
+ *
+ *  The output is a regular LZFSE stream.
+ *
+ *  @return The number of bytes written to \p dst_buffer, or zero if the page
+ *  does not fit. */
+size_t lzfse_compress_page(uint8_t *dst_buffer, size_t dst_size,
+                           const uint8_t *page, void *scratch_buffer);
+
+/*! @abstract Decompress one page compressed by lzfse_compress_page to
+ *  \p page, which receives exactly LZVN_PAGE_SIZE bytes. No scratch buffer
+ *  is needed. Streams that are not a single LZVN or uncompressed block of
+ *  one page are rejected. Use lzfse_decode_buffer for those.
+ *
+ *  @return 0 on success, -1 if the stream is invalid or not a page stream. */
+int lzfse_decompress_page(uint8_t *page, const uint8_t *src_buffer,
+                          size_t src_size);
+
+/*! @abstract One contiguous piece of a segmented buffer (a page, a bio_vec
+ *  or an iovec once mapped). */
+typedef struct {
+  void *base;
+  size_t size;
+} lzfse_segment;
+
+/*! @abstract Get the required scratch buffer size for lzfse_encode_segments.
+ *  This includes a LZFSE_SEGMENT_WINDOW_SIZE bytes window. */
+size_t lzfse_encode_segments_scratch_size(void);
+
+/*! @abstract Same as lzfse_encode_buffer, with the source made of the
+ *  \p n_src segments of \p src, in order. Matches are found across segment
+ *  boundaries; the output is the same as for the concatenated input, except
+ *  for inputs larger than the window, which are encoded as they slide through
+ *  it. No allocation is made, \p scratch_buffer is required. */
+size_t lzfse_encode_segments(uint8_t *dst_buffer, size_t dst_size,
+                             const lzfse_segment *src, size_t n_src,
+                             void *scratch_buffer);
+
+/*! @abstract Get the required scratch buffer size for lzfse_decode_segments.
+ *  This includes a LZFSE_SEGMENT_WINDOW_SIZE bytes window. */
+size_t lzfse_decode_segments_scratch_size(void);
+
+/*! @abstract Same as lzfse_decode_buffer, with the destination made of the
+ *  \p n_dst segments of \p dst, in order. Matches may reference output in
+ *  earlier segments. A single segment is decoded in place; otherwise the
+ *  output goes through a window in \p scratch_buffer that keeps enough
+ *  history for any match, and is copied out to the segments. No allocation is
+ *  made, \p scratch_buffer is required. */
+size_t lzfse_decode_segments(const lzfse_segment *dst, size_t n_dst,
+                             const uint8_t *src_buffer, size_t src_size,
+                             void *scratch_buffer);
+
+/*! @abstract Get the required scratch buffer size for lzfse_cluster_encode. */
+size_t lzfse_cluster_encode_scratch_size(void);
+
+/*! @abstract Compress \p n_pages pages of \p page_size bytes, stored
+ *  contiguously at \p src_buffer, as a page cluster.
+ *
+ *  Pages are split into groups of \p restart_interval pages, each encoded
+ *  as one LZFSE stream, so that pages of a group share history. A table of
+ *  group offsets stored in the cluster header gives a restart point for each
+ *  group. Decoding any single page then costs at most \p restart_interval
+ *  pages of decoding: use 1 for independent pages, and \p n_pages for the
+ *  best ratio.
+ *
+ *  @return The size of the cluster, or zero if it does not fit in
+ *  \p dst_size bytes or the parameters are invalid.                        */
+size_t lzfse_cluster_encode(uint8_t *dst_buffer, size_t dst_size,
+                            const uint8_t *src_buffer, size_t n_pages,
+                            size_t page_size, size_t restart_interval,
+                            void *scratch_buffer);
+
+/*! @abstract Get the required scratch buffer size for lzfse_cluster_decode
+ *  and lzfse_cluster_decode_page, for clusters with the given page size and
+ *  restart interval. */
+size_t lzfse_cluster_decode_scratch_size(size_t page_size,
+                                         size_t restart_interval);
+
+/*! @abstract Decompress all the pages of a cluster to \p dst_buffer.
+ *  @return The number of bytes written, n_pages * page_size, or zero if the
+ *  cluster is invalid or does not fit in \p dst_size bytes. */
+size_t lzfse_cluster_decode(uint8_t *dst_buffer, size_t dst_size,
+                            const uint8_t *src_buffer, size_t src_size,
+                            void *scratch_buffer);
+
+/*! @abstract Decompress page \p index of a cluster to \p page, which
+ *  receives \p page_size bytes. Only the group holding the page is read, and
+ *  it is decoded up to the end of the page. \p scratch_buffer must hold
+ *  lzfse_cluster_decode_scratch_size(page_size, restart_interval) bytes.
+ *  @return 0 on success, -1 if the cluster is invalid, \p index is out of
+ *  range, or the cluster header does not match \p page_size or has a
+ *  restart interval larger than \p restart_interval. */
+int lzfse_cluster_decode_page(uint8_t *page, size_t page_size, size_t index,
+                              const uint8_t *src_buffer, size_t src_size,
+                              void *scratch_buffer, size_t restart_interval);
+
+/*! @abstract Encoder stages timed by builds with LZFSE_INSTRUMENT=1. */
+enum {
+  LZFSE_STAGE_OTHER = 0,    // not timed: outside of the stages below
+  LZFSE_STAGE_MATCH_SEARCH, // lzfse_encode_base match search
+  LZFSE_STAGE_HISTOGRAM,    // symbol counts and fse_normalize_freq
+  LZFSE_STAGE_TABLES,       // fse_init_encoder_table
+  LZFSE_STAGE_LITERALS,     // FSE literal encoding
+  LZFSE_STAGE_LMD,          // FSE L, M, D encoding
+  LZFSE_STAGE_HEADER,       // v2 block header packing
+  LZVN_STAGE_SEARCH,        // lzvn_encode match search
+  LZVN_STAGE_EMIT,          // LZVN opcode emission
+  LZFSE_STAGES
+};
+
+/*! @abstract Get the cycles spent in each encoder stage since the last
+ *  lzfse_instrument_reset( ), summed over all CPUs in the kernel, and for the
+ *  calling thread in userspace. Cycles are TSC cycles on x86, and
+ *  nanoseconds on other userspace targets. Time outside of the stages is not
+ *  counted, and cycles[LZFSE_STAGE_OTHER] is always 0. All zeros unless built
+ *  with LZFSE_INSTRUMENT=1. */
+void lzfse_instrument_read(uint64_t cycles[LZFSE_STAGES]);
+
+/*! @abstract Clear the counters read by lzfse_instrument_read( ). */
+void lzfse_instrument_reset(void);
+
+/*! @abstract Get the short name of encoder stage \p stage. */
+const char *lzfse_instrument_stage_name(int stage);
+
+/*! @abstract Block metadata, as stored in a block header. */
+typedef struct {
+  //  Block magic number (one of the LZFSE_*_BLOCK_MAGIC values).
+  uint32_t magic;
+  //  Size of the block header in bytes.
+  uint32_t header_size;
+  //  Number of decoded (output) bytes, 0 for the end of stream block.
+  uint32_t n_raw_bytes;
+  //  Number of encoded bytes following the header. The next block starts at
+  //  header_size + n_payload_bytes.
+  uint32_t n_payload_bytes;
+  //  LZFSE compressed blocks only, 0 otherwise: number of literals and
+  //  matches, and size and final bit count of their FSE payloads.
+  uint32_t n_literals;
+  uint32_t n_matches;
+  uint32_t n_literal_payload_bytes;
+  uint32_t n_lmd_payload_bytes;
+  int32_t literal_bits;
+  int32_t lmd_bits;
+} lzfse_block_info;
+
+/*! @abstract Parse the header of the block starting at \p src_buffer into
+ *  \p info, without decoding frequency tables or payload. Walking a stream
+ *  block by block with this function only touches the block headers.
+ *
+ *  @return LZFSE_STATUS_OK on success.
+ *  @return LZFSE_STATUS_SRC_EMPTY if \p src_size is too small to hold the
+ *  header.
+ *  @return LZFSE_STATUS_ERROR if the magic or header fields are invalid.     */
+int lzfse_decode_block_info(const uint8_t *src_buffer, size_t src_size,
+                            lzfse_block_info *info);
+
 
 //  Throughout LZFSE we refer to "L", "M" and "D"; these will always appear as
 //  a triplet, and represent a "usual" LZ-style literal and match pair.  "L"
@@ -122,6 +419,26 @@ size_t lzfse_decode_buffer(uint8_t *dst_buffer,
 #define LZFSE_LITERALS_PER_BLOCK (4 * LZFSE_MATCHES_PER_BLOCK)
 #define LZFSE_DECODE_LITERALS_PER_BLOCK (4 * LZFSE_DECODE_MATCHES_PER_BLOCK)
 
+/*! @abstract Normalized symbol frequencies of an LZFSE compressed block, as
+ *  stored in its header. Each table sums to its number of states. */
+typedef struct {
+  uint16_t l_freq[LZFSE_ENCODE_L_SYMBOLS];
+  uint16_t m_freq[LZFSE_ENCODE_M_SYMBOLS];
+  uint16_t d_freq[LZFSE_ENCODE_D_SYMBOLS];
+  uint16_t literal_freq[LZFSE_ENCODE_LITERAL_SYMBOLS];
+} lzfse_block_freq;
+
+/*! @abstract Decode the frequency tables of the block starting at
+ *  \p src_buffer into \p freq. Tables are all zeros for blocks other than
+ *  LZFSE compressed blocks.
+ *
+ *  @return LZFSE_STATUS_OK on success.
+ *  @return LZFSE_STATUS_SRC_EMPTY if \p src_size is too small to hold the
+ *  header.
+ *  @return LZFSE_STATUS_ERROR if the header is invalid.                      */
+int lzfse_decode_block_freq(const uint8_t *src_buffer, size_t src_size,
+                            lzfse_block_freq *freq);
+
 //  LZFSE internal status. These values are used by internal LZFSE routines
 //  as return codes.  There should not be any good reason to change their
 //  values; it is plausible that additional codes might be added in the
@@ -134,12 +451,15 @@ size_t lzfse_decode_buffer(uint8_t *dst_buffer,
 
 //  Select between 32/64-bit I/O streams for FSE. Note that the FSE stream
 //  size need not match the word size of the machine, but in practice you
-//  want to use 64b streams on 64b systems for better performance.
+//  want to use 64b streams on 64b systems for better performance. Can be
+//  forced with -DFSE_IOSTREAM_64=0 or 1, see lzfse_fse_bench.
+#ifndef FSE_IOSTREAM_64
 #if defined(_M_AMD64) || defined(__x86_64__) || defined(__arm64__)
 #define FSE_IOSTREAM_64 1
 #else
 #define FSE_IOSTREAM_64 0
 #endif
+#endif
 
 // MARK: - Bit utils
 
@@ -202,6 +522,8 @@ typedef fse_in_stream64 fse_in_stream;
 #define fse_in_checked_flush fse_in_checked_flush64
 #define fse_in_flush2(_unused, _parameters, _unused2) 0 /* nothing */
 #define fse_in_checked_flush2(_unused, _parameters)     /* nothing */
+#define fse_in_unchecked_flush fse_in_unchecked_flush64
+#define fse_in_unchecked_flush2(_unused, _parameters)   /* nothing */
 #define fse_in_pull fse_in_pull64
 
 #else
@@ -221,6 +543,8 @@ typedef fse_in_stream32 fse_in_stream;
 #define fse_in_checked_flush fse_in_checked_flush32
 #define fse_in_flush2 fse_in_checked_flush32
 #define fse_in_checked_flush2 fse_in_checked_flush32
+#define fse_in_unchecked_flush fse_in_unchecked_flush32
+#define fse_in_unchecked_flush2 fse_in_unchecked_flush32
 #define fse_in_pull fse_in_pull32
 
 #endif
@@ -344,6 +668,21 @@ typedef struct {
   uint32_t n_matches;
   //  The number of literals written so far.
   uint32_t n_literals;
+  //  Nonzero if the encoder may give up as soon as the output provably
+  //  cannot fit in the destination buffer (see lzfse_encode_over_budget).
+  int early_abort;
+  //  Number of LZFSE blocks written so far. lzfse_encode_buffer and
+  //  lzfse_encode_segments only add them to the statistics once the stream
+  //  is complete: until then, they may still discard them and store the
+  //  input uncompressed.
+  uint32_t n_blocks;
+  //  Stage being timed and its start, in LZFSE_INSTRUMENT=1 builds.
+  int instrument_stage;
+  uint64_t instrument_start;
+  //  Number of literals of the current block counted in literal_hist, and
+  //  their histogram.
+  uint32_t literal_hist_n;
+  uint32_t literal_hist[LZFSE_ENCODE_LITERAL_SYMBOLS];
   //  Lengths of found literals.
   uint32_t l_values[LZFSE_MATCHES_PER_BLOCK];
   //  Lengths of found matches.
@@ -369,6 +708,9 @@ typedef struct {      // DO NOT REORDER THE FIELDS
 
 /*! @abstract Decoder state object for lzfse compressed blocks. */
 typedef struct {
+  //  Number of decoded bytes and of literals in the block.
+  uint32_t n_raw_bytes;
+  uint32_t n_literals;
   //  Number of matches remaining in the block.
   uint32_t n_matches;
   //  Number of bytes used to encode L, M, D triplets for the block.
@@ -394,6 +736,16 @@ typedef struct {
   fse_value_decoder_entry m_decoder[LZFSE_ENCODE_M_STATES] __attribute__((__aligned__(8)));
   fse_value_decoder_entry d_decoder[LZFSE_ENCODE_D_STATES] __attribute__((__aligned__(8)));
   int32_t literal_decoder[LZFSE_ENCODE_LITERAL_STATES];
+  //  Hashes of the normalized frequency tables the decoder tables above were
+  //  built from, and copies of those frequency tables. Consecutive blocks of
+  //  homogeneous data often carry identical tables; when a new block's tables
+  //  match, the decoder tables are reused instead of being rebuilt. A hash of
+  //  0 marks a decoder table that has not been built yet.
+  uint32_t l_freq_hash, m_freq_hash, d_freq_hash, literal_freq_hash;
+  uint16_t l_freq[LZFSE_ENCODE_L_SYMBOLS];
+  uint16_t m_freq[LZFSE_ENCODE_M_SYMBOLS];
+  uint16_t d_freq[LZFSE_ENCODE_D_SYMBOLS];
+  uint16_t literal_freq[LZFSE_ENCODE_LITERAL_SYMBOLS];
   //  The literal stream for the block, plus padding to allow for faster copy
   //  operations.
   uint8_t literals[LZFSE_LITERALS_PER_BLOCK + 64];
@@ -402,6 +754,16 @@ typedef struct {
 //  Decoder state object for uncompressed blocks.
 typedef struct { uint32_t n_raw_bytes; } uncompressed_block_decoder_state;
 
+//  Block types counted by the statistics
+enum {
+  LZFSE_STAT_BLOCK_UNCOMPRESSED = 0,
+  LZFSE_STAT_BLOCK_LZVN,
+  LZFSE_STAT_BLOCK_V1,
+  LZFSE_STAT_BLOCK_V2,
+  LZFSE_STAT_BLOCK_ENDOFSTREAM,
+  LZFSE_STAT_BLOCK_TYPES
+};
+
 /*! @abstract Decoder state object. */
 typedef struct {
   //  Pointer to next byte to read from source buffer (this is advanced as we
@@ -423,6 +785,22 @@ typedef struct {
   //  magic number of the current block if we are within a block,
   //  LZFSE_NO_BLOCK_MAGIC otherwise.
   uint32_t block_magic;
+  //  1 if the source is known to be well formed, and LZFSE blocks may be
+  //  decoded without per-match checks (see lzfse_decode_buffer_trusted),
+  //  0 otherwise.
+  int trusted;
+  //  1 if the source is stored at the end of the destination buffer (see
+  //  lzfse_decode_buffer_inplace), 0 otherwise. Uncompressed blocks may then
+  //  overlap their output and are copied with memmove.
+  int in_place;
+  //  1 if blocks are only checked, without writing to the destination buffer
+  //  (see lzfse_validate_buffer), 0 otherwise. In that case, validated_bytes
+  //  counts the bytes that would have been written, and replaces dst.
+  int validate;
+  size_t validated_bytes;
+  //  Blocks started since the decoder was pointed at the stream, by type.
+  //  The decode functions add them to the statistics with the call.
+  uint32_t n_blocks[LZFSE_STAT_BLOCK_TYPES];
   lzfse_compressed_block_decoder_state compressed_lzfse_block_state;
   lzvn_compressed_block_decoder_state compressed_lzvn_block_state;
   uncompressed_block_decoder_state uncompressed_block_state;
@@ -0,0 +1,1069 @@
+/*
+  Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+  2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+  in the documentation and/or other materials provided with the distribution.
+
+  3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Benchmark for the LZFSE and LZVN buffer APIs over a corpus directory and
+// synthetic inputs. Reports throughput, ratio, cycles/byte and per-call
+// latency percentiles for each buffer size, optionally as JSON. Libraries
+// built with LZFSE_INSTRUMENT=1 add a per-stage encoder breakdown. With -c,
+// compares against a previous JSON result and fails on regressions.
+
+#include "lzfse.h"
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#define MAX_SIZES 16
+#define MAX_INPUTS 256
+#define MAX_RUNS 64
+
+enum { CODEC_LZFSE = 0, CODEC_LZVN, N_CODECS };
+static const char *codec_names[N_CODECS] = { "lzfse", "lzvn" };
+
+typedef struct {
+	char name[256];
+	uint8_t *data;
+	size_t size;
+} bench_input;
+
+// Latency samples of one operation, in ns
+typedef struct {
+	uint64_t *ns;
+	size_t n, allocated;
+	double seconds; // total time
+	uint64_t cycles; // total TSC cycles, 0 if unavailable
+	size_t bytes;   // total raw bytes
+} bench_samples;
+
+typedef struct {
+	const char *input;
+	size_t size;
+	int codec;
+	size_t raw_bytes, compressed_bytes;
+	double mbps[2], cpb[2], p50_us[2], p90_us[2], p99_us[2];
+	int runs;
+	double mbps_sd[2]; // standard deviation of mbps over the runs
+	double stage_cpb[LZFSE_STAGES]; // encode cycles/byte per stage
+	int has_stages; // library counts stage cycles
+} bench_result;
+
+enum { OP_ENCODE = 0, OP_DECODE };
+
+static double min_time = 0.5; // seconds per measurement
+static int n_runs = 1; // measurements per operation
+
+static void usage(const char *argv0) {
+	fprintf(stderr,
+		"Usage: %s [-d corpus_dir] [-g generators] [-s sizes] [-l length]\n"
+		"          [-t seconds] [-r runs] [-j json_file]\n"
+		"          [-c baseline_json [-T tolerance_percent]] [-h]\n"
+		"  -d  benchmark every regular file in corpus_dir\n"
+		"  -g  comma separated synthetic inputs among\n"
+		"      text,zeros,random,logs,binary (default: all, none to skip)\n"
+		"  -s  comma separated buffer sizes (default: 4096,65536,1048576)\n"
+		"  -l  length of the synthetic inputs (default: 4194304)\n"
+		"  -t  minimum time per measurement in seconds (default: 0.5)\n"
+		"  -r  measurements per operation, for the confidence intervals\n"
+		"      (default: 1, or 5 with -j or -c)\n"
+		"  -j  write the results as JSON to json_file, - for stdout\n"
+		"  -c  compare with the JSON results in baseline_json, measured with\n"
+		"      the same -d, -g and -l; sizes default to the baseline ones.\n"
+		"      Exits with status 2 if a regression is found\n"
+		"  -T  throughput changes within this percentage are not flagged\n"
+		"      (default: 2)\n",
+		argv0);
+}
+
+static void *xmalloc(size_t size) {
+	void *p = malloc(size ? size : 1);
+
+	if (p == NULL) {
+		fprintf(stderr, "Error: cannot allocate %zu bytes\n", size);
+		exit(1);
+	}
+	return p;
+}
+
+static double now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static uint64_t cycles(void) {
+#if HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// MARK: - Synthetic inputs
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t rng(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (uint32_t)(rng_state >> 16);
+}
+
+// Skewed index in [0, n), small values being the most frequent
+static uint32_t rng_skewed(uint32_t n) {
+	uint32_t a = rng() % n, b = rng() % n;
+	return (uint32_t)((uint64_t)a * b / n);
+}
+
+static const char *words[] = {
+	"the", "of", "and", "to", "in", "a", "is", "that", "for", "it",
+	"as", "was", "with", "be", "by", "on", "not", "he", "this", "are",
+	"or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+	"compression", "buffer", "stream", "block", "literal", "match",
+	"distance", "entropy", "decoder", "encoder", "history", "window",
+	"kernel", "module", "storage", "request", "latency", "throughput",
+};
+#define N_WORDS (sizeof(words) / sizeof(words[0]))
+
+static void gen_text(uint8_t *p, size_t n) {
+	size_t i = 0;
+	int col = 0;
+
+	while (i < n) {
+		const char *w = words[rng_skewed(N_WORDS)];
+		while (*w && i < n) {
+			p[i++] = *w++;
+			col++;
+		}
+		if (i < n) {
+			uint32_t r = rng() % 16;
+			p[i++] = (col > 70) ? '\n' : (r == 0) ? ',' : (r == 1) ? '.' : ' ';
+			if (col > 70)
+				col = 0;
+		}
+	}
+}
+
+static void gen_zeros(uint8_t *p, size_t n) { memset(p, 0, n); }
+
+static void gen_random(uint8_t *p, size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		p[i] = (uint8_t)rng();
+}
+
+static void gen_logs(uint8_t *p, size_t n) {
+	static const char *levels[] = { "INFO", "INFO", "INFO", "WARN", "DEBUG", "ERROR" };
+	static const char *paths[] = { "/api/v1/items", "/api/v1/users", "/healthz",
+				       "/api/v2/search", "/static/app.js" };
+	uint64_t t = 1700000000000ULL;
+	size_t i = 0;
+
+	while (i < n) {
+		char line[256];
+		int len;
+
+		t += rng() % 50;
+		len = snprintf(line, sizeof(line),
+			       "%llu.%03llu host-%02u svc[%u]: %s request id=%08x "
+			       "path=%s/%u status=%u latency=%ums\n",
+			       (unsigned long long)(t / 1000),
+			       (unsigned long long)(t % 1000), rng() % 16,
+			       1000 + rng() % 8, levels[rng() % 6], rng(),
+			       paths[rng_skewed(5)], rng() % 10000,
+			       (rng() % 20) ? 200 : 500, rng_skewed(500));
+		if ((size_t)len > n - i)
+			len = (int)(n - i);
+		memcpy(p + i, line, len);
+		i += len;
+	}
+}
+
+// Fixed size records mixing counters, pointers, small integers, padding and
+// a few recurring instruction-like byte sequences
+static void gen_binary(uint8_t *p, size_t n) {
+	static const uint8_t code[][8] = {
+		{ 0x55, 0x48, 0x89, 0xe5, 0x48, 0x83, 0xec, 0x20 },
+		{ 0x48, 0x8b, 0x45, 0xf8, 0x48, 0x89, 0xc7, 0xe8 },
+		{ 0x5d, 0xc3, 0x0f, 0x1f, 0x44, 0x00, 0x00, 0x90 },
+		{ 0x31, 0xc0, 0x48, 0x85, 0xff, 0x74, 0x0a, 0x8b },
+	};
+	uint64_t ptr = 0xffff888000100000ULL;
+	uint32_t id = 0;
+	size_t i = 0;
+
+	while (i < n) {
+		uint8_t rec[32];
+		uint32_t small = rng_skewed(256);
+
+		ptr += 64 * (1 + rng() % 4);
+		memcpy(rec, &id, 4);
+		memcpy(rec + 4, &small, 4);
+		memcpy(rec + 8, &ptr, 8);
+		memcpy(rec + 16, code[rng() % 4], 8);
+		memset(rec + 24, 0, 8);
+		if (rng() % 4 == 0)
+			memcpy(rec + 24, code[rng() % 4], 8);
+		id++;
+		memcpy(p + i, rec, n - i < 32 ? n - i : 32);
+		i += 32;
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*gen)(uint8_t *, size_t);
+} generators[] = {
+	{ "text", gen_text },	  { "zeros", gen_zeros },
+	{ "random", gen_random }, { "logs", gen_logs },
+	{ "binary", gen_binary },
+};
+#define N_GENERATORS (sizeof(generators) / sizeof(generators[0]))
+
+// MARK: - Inputs
+
+static int add_input(bench_input *inputs, int n_inputs, const char *name,
+		     uint8_t *data, size_t size) {
+	if (n_inputs == MAX_INPUTS) {
+		fprintf(stderr, "Error: too many inputs\n");
+		exit(1);
+	}
+	snprintf(inputs[n_inputs].name, sizeof(inputs[n_inputs].name), "%s",
+		 name);
+	inputs[n_inputs].data = data;
+	inputs[n_inputs].size = size;
+	return n_inputs + 1;
+}
+
+static int load_file(const char *path, uint8_t **data, size_t *size) {
+	FILE *f = fopen(path, "rb");
+	struct stat st;
+
+	if (f == NULL || fstat(fileno(f), &st) != 0) {
+		perror(path);
+		if (f)
+			fclose(f);
+		return -1;
+	}
+	*size = st.st_size;
+	*data = xmalloc(*size);
+	if (fread(*data, 1, *size, f) != *size) {
+		perror(path);
+		fclose(f);
+		free(*data);
+		return -1;
+	}
+	fclose(f);
+	return 0;
+}
+
+static int compare_names(const void *a, const void *b) {
+	return strcmp(((const bench_input *)a)->name,
+		      ((const bench_input *)b)->name);
+}
+
+// Add the regular files of DIR, sorted by name
+static int load_corpus(bench_input *inputs, int n_inputs, const char *dir) {
+	DIR *d = opendir(dir);
+	struct dirent *e;
+	int first = n_inputs;
+
+	if (d == NULL) {
+		perror(dir);
+		exit(1);
+	}
+	while ((e = readdir(d)) != NULL) {
+		char path[4096];
+		struct stat st;
+		uint8_t *data;
+		size_t size;
+
+		snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+		if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) ||
+		    st.st_size == 0)
+			continue;
+		if (load_file(path, &data, &size) != 0)
+			continue;
+		n_inputs = add_input(inputs, n_inputs, e->d_name, data, size);
+	}
+	closedir(d);
+	qsort(inputs + first, n_inputs - first, sizeof(*inputs),
+	      compare_names);
+	return n_inputs;
+}
+
+// MARK: - Measurements
+
+static void add_sample(bench_samples *s, uint64_t ns) {
+	if (s->n == s->allocated) {
+		s->allocated = s->allocated ? 2 * s->allocated : 4096;
+		s->ns = realloc(s->ns, s->allocated * sizeof(*s->ns));
+		if (s->ns == NULL) {
+			fprintf(stderr, "Error: cannot allocate samples\n");
+			exit(1);
+		}
+	}
+	s->ns[s->n++] = ns;
+}
+
+static int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// Percentile P in [0, 100] of sorted samples, in us
+static double percentile_us(const bench_samples *s, double p) {
+	size_t i;
+
+	if (s->n == 0)
+		return 0;
+	i = (size_t)(p / 100 * (s->n - 1) + 0.5);
+	return s->ns[i] * 1e-3;
+}
+
+static size_t run_encode(int codec, uint8_t *dst, size_t dst_size,
+			 const uint8_t *src, size_t src_size, void *scratch) {
+	if (codec == CODEC_LZFSE)
+		return lzfse_encode_buffer(dst, dst_size, src, src_size,
+					   scratch);
+	return lzvn_encode_buffer(dst, dst_size, src, src_size, scratch);
+}
+
+static size_t run_decode(int codec, uint8_t *dst, size_t dst_size,
+			 const uint8_t *src, size_t src_size, void *scratch) {
+	if (codec == CODEC_LZFSE)
+		return lzfse_decode_buffer(dst, dst_size, src, src_size,
+					   scratch);
+	return lzvn_decode_buffer(dst, dst_size, src, src_size, scratch);
+}
+
+// Benchmark CODEC on INPUT split in buffers of SIZE bytes. Buffers LZVN
+// cannot compress are stored and excluded from the decode timing.
+static void bench_one(const bench_input *input, size_t size, int codec,
+		      void *scratch, bench_result *r) {
+	size_t n_buffers = input->size / size;
+	size_t buffer_size = size;
+	size_t capacity, b;
+	uint8_t *enc, *dec;
+	size_t *enc_size;
+	bench_samples s[2];
+	int op;
+
+	if (n_buffers == 0) {
+		n_buffers = 1;
+		buffer_size = input->size;
+	}
+	capacity = 2 * buffer_size + 4096;
+	enc = xmalloc(n_buffers * capacity);
+	enc_size = xmalloc(n_buffers * sizeof(*enc_size));
+	dec = xmalloc(buffer_size);
+	memset(s, 0, sizeof(s));
+
+	memset(r, 0, sizeof(*r));
+	r->input = input->name;
+	r->size = size;
+	r->codec = codec;
+
+	// Compressed sizes, and decode check
+	for (b = 0; b < n_buffers; b++) {
+		const uint8_t *src = input->data + b * buffer_size;
+		enc_size[b] = run_encode(codec, enc + b * capacity, capacity,
+					 src, buffer_size, scratch);
+		r->raw_bytes += buffer_size;
+		r->compressed_bytes += enc_size[b] ? enc_size[b] : buffer_size;
+		if (enc_size[b] == 0)
+			continue;
+		if (run_decode(codec, dec, buffer_size, enc + b * capacity,
+			       enc_size[b], scratch) != buffer_size ||
+		    memcmp(dec, src, buffer_size) != 0) {
+			fprintf(stderr, "Error: %s %s/%zu: round trip failed\n",
+				codec_names[codec], input->name, size);
+			exit(1);
+		}
+	}
+
+	// Repeat passes over all buffers until MIN_TIME is reached, N_RUNS times
+	r->runs = n_runs;
+	for (op = OP_ENCODE; op <= OP_DECODE; op++) {
+		double run_mbps[MAX_RUNS];
+		double sum = 0, var = 0;
+		int run;
+
+		if (op == OP_ENCODE)
+			lzfse_instrument_reset();
+
+		for (run = 0; run < n_runs; run++) {
+			double t0 = now();
+			uint64_t c0 = cycles();
+			size_t bytes0 = s[op].bytes;
+
+			do {
+				for (b = 0; b < n_buffers; b++) {
+					uint64_t t;
+
+					if (op == OP_DECODE && enc_size[b] == 0)
+						continue;
+					t = now_ns();
+					if (op == OP_ENCODE)
+						run_encode(codec, enc + b * capacity,
+							   capacity,
+							   input->data + b * buffer_size,
+							   buffer_size, scratch);
+					else
+						run_decode(codec, dec, buffer_size,
+							   enc + b * capacity,
+							   enc_size[b], scratch);
+					add_sample(&s[op], now_ns() - t);
+					s[op].bytes += buffer_size;
+				}
+			} while (now() - t0 < min_time && s[op].bytes > bytes0);
+			t0 = now() - t0;
+			s[op].seconds += t0;
+			s[op].cycles += cycles() - c0;
+			run_mbps[run] = t0 > 0 ? (s[op].bytes - bytes0) / t0 * 1e-6 : 0;
+			sum += run_mbps[run];
+		}
+		for (run = 0; run < n_runs; run++)
+			var += (run_mbps[run] - sum / n_runs) *
+			       (run_mbps[run] - sum / n_runs);
+		r->mbps_sd[op] = n_runs > 1 ? sqrt(var / (n_runs - 1)) : 0;
+		if (op == OP_ENCODE && s[op].bytes > 0) {
+			uint64_t stage_cycles[LZFSE_STAGES];
+			int i;
+
+			// Time outside of the stages is not counted, "other" is
+			// derived from the wall cycles instead
+			lzfse_instrument_read(stage_cycles);
+			for (i = LZFSE_STAGE_OTHER + 1; i < LZFSE_STAGES; i++) {
+				r->stage_cpb[i] = (double)stage_cycles[i] / s[op].bytes;
+				if (stage_cycles[i])
+					r->has_stages = 1;
+			}
+		}
+
+		qsort(s[op].ns, s[op].n, sizeof(*s[op].ns), compare_u64);
+		r->mbps[op] = sum / n_runs;
+		r->cpb[op] = s[op].bytes ? (double)s[op].cycles / s[op].bytes : 0;
+		r->p50_us[op] = percentile_us(&s[op], 50);
+		r->p90_us[op] = percentile_us(&s[op], 90);
+		r->p99_us[op] = percentile_us(&s[op], 99);
+		free(s[op].ns);
+	}
+
+	free(dec);
+	free(enc_size);
+	free(enc);
+}
+
+// MARK: - Output
+
+static void print_header(FILE *f) {
+	fprintf(f, "%-16s %8s %6s %7s | %9s %7s %8s %8s | %9s %7s %8s %8s\n",
+	       "input", "size", "codec", "ratio", "enc MB/s", "enc c/B",
+	       "p50 us", "p99 us", "dec MB/s", "dec c/B", "p50 us", "p99 us");
+}
+
+static void print_result(FILE *f, const bench_result *r) {
+	fprintf(f, "%-16.16s %8zu %6s %7.3f | %9.1f %7.2f %8.1f %8.1f | %9.1f %7.2f %8.1f %8.1f\n",
+	       r->input, r->size, codec_names[r->codec],
+	       r->compressed_bytes ? (double)r->raw_bytes / r->compressed_bytes : 0,
+	       r->mbps[OP_ENCODE], r->cpb[OP_ENCODE], r->p50_us[OP_ENCODE],
+	       r->p99_us[OP_ENCODE], r->mbps[OP_DECODE], r->cpb[OP_DECODE],
+	       r->p50_us[OP_DECODE], r->p99_us[OP_DECODE]);
+	if (r->has_stages) {
+		double other = r->cpb[OP_ENCODE];
+		int i;
+
+		fprintf(f, "  encode stages c/B:");
+		for (i = LZFSE_STAGE_OTHER + 1; i < LZFSE_STAGES; i++) {
+			if (r->stage_cpb[i] == 0)
+				continue;
+			fprintf(f, " %s %.2f", lzfse_instrument_stage_name(i),
+				r->stage_cpb[i]);
+			other -= r->stage_cpb[i];
+		}
+		// Call overhead, setup, and everything outside the stages
+		fprintf(f, " %s %.2f\n", lzfse_instrument_stage_name(LZFSE_STAGE_OTHER),
+			other > 0 ? other : 0);
+	}
+	fflush(f);
+}
+
+static void print_json_string(FILE *f, const char *s) {
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(f, "\\u%04x", *s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+// One result per line, so that the file is easy to diff and to parse
+static void write_json(FILE *f, const bench_result *results, size_t n) {
+	static const char *ops[2] = { "encode", "decode" };
+	size_t i;
+	int op;
+
+	fprintf(f, "{\n  \"version\": 2,\n  \"min_time\": %g,\n  \"runs\": %d,\n"
+		   "  \"cycles\": \"%s\",\n  \"results\": [\n",
+		min_time, n_runs, HAVE_TSC ? "tsc" : "none");
+	for (i = 0; i < n; i++) {
+		const bench_result *r = &results[i];
+		fprintf(f, "    {\"input\": ");
+		print_json_string(f, r->input);
+		fprintf(f, ", \"size\": %zu, \"codec\": \"%s\", "
+			   "\"raw_bytes\": %zu, \"compressed_bytes\": %zu, "
+			   "\"ratio\": %.4f, \"runs\": %d",
+			r->size, codec_names[r->codec], r->raw_bytes,
+			r->compressed_bytes,
+			r->compressed_bytes ? (double)r->raw_bytes / r->compressed_bytes : 0,
+			r->runs);
+		for (op = OP_ENCODE; op <= OP_DECODE; op++)
+			fprintf(f, ", \"%s_mbps\": %.2f, \"%s_mbps_sd\": %.3f, "
+				   "\"%s_cpb\": %.3f, "
+				   "\"%s_p50_us\": %.2f, \"%s_p90_us\": %.2f, "
+				   "\"%s_p99_us\": %.2f",
+				ops[op], r->mbps[op], ops[op], r->mbps_sd[op],
+				ops[op], r->cpb[op],
+				ops[op], r->p50_us[op], ops[op], r->p90_us[op],
+				ops[op], r->p99_us[op]);
+		if (r->has_stages) {
+			int k;
+
+			fprintf(f, ", \"encode_stage_cpb\": {");
+			for (k = LZFSE_STAGE_OTHER + 1; k < LZFSE_STAGES; k++)
+				fprintf(f, "%s\"%s\": %.3f", k > 1 ? ", " : "",
+					lzfse_instrument_stage_name(k),
+					r->stage_cpb[k]);
+			fprintf(f, "}");
+		}
+		fprintf(f, "}%s\n", i + 1 < n ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+}
+
+// MARK: - Baseline comparison
+
+// Find "KEY": in LINE, and return a pointer to its value
+static const char *json_find(const char *line, const char *key) {
+	char pattern[64];
+	const char *p;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+	p = strstr(line, pattern);
+	return p ? p + strlen(pattern) : NULL;
+}
+
+static int json_number(const char *line, const char *key, double *v) {
+	const char *p = json_find(line, key);
+	char *end;
+
+	if (p == NULL)
+		return -1;
+	*v = strtod(p, &end);
+	return end == p ? -1 : 0;
+}
+
+// Read the string value of KEY to BUF, undoing print_json_string
+static int json_string(const char *line, const char *key, char *buf,
+		       size_t size) {
+	const char *p = json_find(line, key);
+	size_t n = 0;
+
+	if (p == NULL || *p++ != '"')
+		return -1;
+	for (; *p && *p != '"'; p++) {
+		char c = *p;
+
+		unsigned u;
+
+		if (c == '\\' && p[1] == 'u' && sscanf(p + 2, "%4x", &u) == 1) {
+			c = (char)u;
+			p += 5;
+		} else if (c == '\\' && p[1]) {
+			c = *++p;
+		}
+		if (n + 1 < size)
+			buf[n++] = c;
+	}
+	buf[n] = 0;
+	return *p == '"' ? 0 : -1;
+}
+
+// Load the results of a JSON file written by write_json, one result per
+// line. Version 1 files have no standard deviations, which are then 0.
+static size_t load_baseline(const char *path, bench_result **results,
+			    char (**names)[256]) {
+	static const char *ops[2] = { "encode", "decode" };
+	FILE *f = fopen(path, "r");
+	char line[4096];
+	size_t n = 0, allocated = 64;
+	bench_result *r = xmalloc(allocated * sizeof(*r));
+	char (*nm)[256] = xmalloc(allocated * sizeof(*nm));
+
+	if (f == NULL) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char codec[16];
+		double v;
+		int op, k;
+
+		if (json_find(line, "input") == NULL)
+			continue;
+		if (n == allocated) {
+			allocated *= 2;
+			r = realloc(r, allocated * sizeof(*r));
+			nm = realloc(nm, allocated * sizeof(*nm));
+			if (r == NULL || nm == NULL) {
+				fprintf(stderr, "Error: out of memory\n");
+				exit(1);
+			}
+		}
+		memset(&r[n], 0, sizeof(r[n]));
+		if (json_string(line, "input", nm[n], sizeof(nm[n])) != 0 ||
+		    json_string(line, "codec", codec, sizeof(codec)) != 0)
+			goto invalid;
+		r[n].input = nm[n];
+		for (k = 0; k < N_CODECS && strcmp(codec, codec_names[k]) != 0; k++)
+			;
+		if (k == N_CODECS)
+			goto invalid;
+		r[n].codec = k;
+		if (json_number(line, "size", &v) != 0)
+			goto invalid;
+		r[n].size = (size_t)v;
+		if (json_number(line, "raw_bytes", &v) != 0)
+			goto invalid;
+		r[n].raw_bytes = (size_t)v;
+		if (json_number(line, "compressed_bytes", &v) != 0)
+			goto invalid;
+		r[n].compressed_bytes = (size_t)v;
+		r[n].runs = json_number(line, "runs", &v) == 0 ? (int)v : 1;
+		for (op = OP_ENCODE; op <= OP_DECODE; op++) {
+			char key[32];
+
+			snprintf(key, sizeof(key), "%s_mbps", ops[op]);
+			if (json_number(line, key, &r[n].mbps[op]) != 0)
+				goto invalid;
+			snprintf(key, sizeof(key), "%s_mbps_sd", ops[op]);
+			if (json_number(line, key, &r[n].mbps_sd[op]) != 0)
+				r[n].mbps_sd[op] = 0;
+		}
+		n++;
+		continue;
+invalid:
+		fprintf(stderr, "Error: %s: invalid result %s", path, line);
+		exit(1);
+	}
+	fclose(f);
+	*results = r;
+	*names = nm;
+	return n;
+}
+
+// Two-sided 95% quantiles of Student's t distribution, by degrees of freedom
+static const double t95[30] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201,	2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080,	2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+// 95% confidence interval of the relative change from mean MB to mean MC,
+// with Welch's approximation for unequal variances. Both sides need at least
+// 2 runs (NB, NC) to estimate their variance.
+static void change_ci(double mb, double sb, int nb, double mc, double sc,
+		      int nc, double *lo, double *hi) {
+	double vb = sb * sb / nb;
+	double vc = sc * sc / nc;
+	double den = vb * vb / (nb - 1) + vc * vc / (nc - 1);
+	double df = den > 0 ? (vb + vc) * (vb + vc) / den : 0;
+	double t = df < 1 ? t95[0] : df >= 30 ? 1.960 : t95[(int)df - 1];
+	double half = t * sqrt(vb + vc);
+
+	*lo = (mc - mb - half) / mb;
+	*hi = (mc - mb + half) / mb;
+}
+
+// Per codec and size class: geometric mean of the throughput changes
+typedef struct {
+	size_t size;
+	int codec;
+	int inputs, regressions;
+	int n[2];
+	double log_change[2];
+} compare_class;
+
+// Compare RESULTS with BASELINE, print the changes, and return the number of
+// regressions. Throughput regresses when the whole confidence interval of its
+// change is below -TOLERANCE; the ratio regresses as soon as the compressed
+// size of the same input grows. Throughput measured with a single run on
+// either side has no confidence interval and is never flagged.
+static int compare(FILE *f, const bench_result *results, size_t n_results,
+		   const bench_result *baseline, size_t n_baseline,
+		   double tolerance) {
+	static const char *metrics[2] = { "enc MB/s", "dec MB/s" };
+	compare_class classes[MAX_SIZES * N_CODECS];
+	int n_classes = 0, regressions = 0, no_ci = 0;
+	size_t i, j;
+	int op, k;
+
+	fprintf(f, "\n%-16s %8s %6s %-9s %10s %10s %8s %19s  %s\n", "input",
+		"size", "codec", "metric", "baseline", "current", "change",
+		"95% CI", "verdict");
+	for (i = 0; i < n_results; i++) {
+		const bench_result *r = &results[i];
+		const bench_result *b = NULL;
+		compare_class *c;
+		int regressed = 0;
+
+		for (j = 0; j < n_baseline && b == NULL; j++)
+			if (baseline[j].size == r->size &&
+			    baseline[j].codec == r->codec &&
+			    strcmp(baseline[j].input, r->input) == 0)
+				b = &baseline[j];
+		if (b == NULL) {
+			fprintf(f, "%-16.16s %8zu %6s not in baseline\n", r->input,
+				r->size, codec_names[r->codec]);
+			continue;
+		}
+		if (b->raw_bytes != r->raw_bytes) {
+			fprintf(f, "%-16.16s %8zu %6s input differs from baseline\n",
+				r->input, r->size, codec_names[r->codec]);
+			continue;
+		}
+
+		for (k = 0; k < n_classes; k++)
+			if (classes[k].size == r->size && classes[k].codec == r->codec)
+				break;
+		c = &classes[k];
+		if (k == n_classes) {
+			memset(c, 0, sizeof(*c));
+			c->size = r->size;
+			c->codec = r->codec;
+			n_classes++;
+		}
+		c->inputs++;
+
+		for (op = OP_ENCODE; op <= OP_DECODE; op++) {
+			double lo, hi;
+			const char *verdict = "ok";
+
+			if (b->mbps[op] <= 0 || r->mbps[op] <= 0)
+				continue; // nothing decoded, LZVN stored everything
+			c->n[op]++;
+			c->log_change[op] += log(r->mbps[op] / b->mbps[op]);
+			if (b->runs < 2 || r->runs < 2) {
+				fprintf(f, "%-16.16s %8zu %6s %-9s %10.1f %10.1f "
+					   "%+7.1f%% %19s  no CI\n",
+					r->input, r->size, codec_names[r->codec],
+					metrics[op], b->mbps[op], r->mbps[op],
+					100 * (r->mbps[op] / b->mbps[op] - 1), "");
+				no_ci++;
+				continue;
+			}
+			change_ci(b->mbps[op], b->mbps_sd[op], b->runs, r->mbps[op],
+				  r->mbps_sd[op], r->runs, &lo, &hi);
+			if (hi < -tolerance) {
+				verdict = "REGRESSION";
+				regressed = 1;
+			} else if (lo > tolerance) {
+				verdict = "improved";
+			} else if (hi < 0) {
+				verdict = "slower"; // significant, within tolerance
+			} else if (lo > 0) {
+				verdict = "faster";
+			}
+			fprintf(f, "%-16.16s %8zu %6s %-9s %10.1f %10.1f %+7.1f%% "
+				   "[%+7.1f%%,%+7.1f%%]  %s\n",
+				r->input, r->size, codec_names[r->codec],
+				metrics[op], b->mbps[op], r->mbps[op],
+				100 * (r->mbps[op] / b->mbps[op] - 1), 100 * lo,
+				100 * hi, verdict);
+		}
+		fprintf(f, "%-16.16s %8zu %6s %-9s %10.3f %10.3f %+7.2f%% %19s  %s\n",
+			r->input, r->size, codec_names[r->codec], "ratio",
+			(double)b->raw_bytes / b->compressed_bytes,
+			(double)r->raw_bytes / r->compressed_bytes,
+			100 * ((double)b->compressed_bytes / r->compressed_bytes - 1),
+			"", r->compressed_bytes > b->compressed_bytes ? "REGRESSION"
+			    : r->compressed_bytes < b->compressed_bytes ? "better"
+									 : "ok");
+		if (r->compressed_bytes > b->compressed_bytes)
+			regressed = 1;
+		c->regressions += regressed;
+		regressions += regressed;
+	}
+	for (j = 0; j < n_baseline; j++) {
+		for (i = 0; i < n_results; i++)
+			if (results[i].size == baseline[j].size &&
+			    results[i].codec == baseline[j].codec &&
+			    strcmp(results[i].input, baseline[j].input) == 0)
+				break;
+		if (i == n_results)
+			fprintf(f, "%-16.16s %8zu %6s not measured\n",
+				baseline[j].input, baseline[j].size,
+				codec_names[baseline[j].codec]);
+	}
+
+	fprintf(f, "\n%6s %8s %7s %10s %10s %12s\n", "codec", "size", "inputs",
+		"enc geo", "dec geo", "regressions");
+	for (k = 0; k < n_classes; k++) {
+		const compare_class *c = &classes[k];
+
+		fprintf(f, "%6s %8zu %7d", codec_names[c->codec], c->size,
+			c->inputs);
+		for (op = OP_ENCODE; op <= OP_DECODE; op++)
+			fprintf(f, " %+9.1f%%",
+				c->n[op] ? 100 * (exp(c->log_change[op] / c->n[op]) - 1)
+					 : 0);
+		fprintf(f, " %12d\n", c->regressions);
+	}
+	fprintf(f, "%d regression%s (tolerance %.1f%%)\n", regressions,
+		regressions == 1 ? "" : "s", 100 * tolerance);
+	if (no_ci)
+		fprintf(f, "%d throughput change%s not tested: the baseline or "
+			   "the current results have a single run (-r)\n",
+			no_ci, no_ci == 1 ? "" : "s");
+	return regressions;
+}
+
+// MARK: - Main
+
+static size_t parse_size(const char *s) {
+	char *end;
+	unsigned long long v = strtoull(s, &end, 0);
+
+	if (*end == 'k' || *end == 'K')
+		v <<= 10, end++;
+	else if (*end == 'm' || *end == 'M')
+		v <<= 20, end++;
+	if (end == s || (*end != 0 && *end != ',') || v == 0) {
+		fprintf(stderr, "Error: invalid size %s\n", s);
+		exit(1);
+	}
+	return (size_t)v;
+}
+
+int main(int argc, char **argv) {
+	const char *corpus_dir = NULL;
+	const char *gen_list = NULL;
+	const char *json_file = NULL;
+	const char *baseline_file = NULL;
+	bench_result *baseline = NULL;
+	char (*baseline_names)[256] = NULL;
+	size_t n_baseline = 0;
+	double tolerance = 0.02;
+	int regressions = 0;
+	size_t sizes[MAX_SIZES] = { 4096, 65536, 1048576 };
+	int n_sizes = 3, sizes_set = 0, runs_set = 0;
+	size_t length = 4 << 20;
+	bench_input *inputs = xmalloc(MAX_INPUTS * sizeof(*inputs));
+	int n_inputs = 0;
+	bench_result *results;
+	size_t n_results = 0;
+	void *scratch;
+	FILE *table;
+	int i, j, k;
+
+	for (i = 1; i < argc; i++) {
+		const char *a = argv[i];
+
+		if (strcmp(a, "-h") == 0) {
+			usage(argv[0]);
+			return 0;
+		}
+		if (i + 1 == argc) {
+			usage(argv[0]);
+			fprintf(stderr, "Error: invalid flag or missing arg %s\n", a);
+			return 1;
+		}
+		if (strcmp(a, "-d") == 0) {
+			corpus_dir = argv[++i];
+		} else if (strcmp(a, "-g") == 0) {
+			gen_list = argv[++i];
+		} else if (strcmp(a, "-j") == 0) {
+			json_file = argv[++i];
+		} else if (strcmp(a, "-l") == 0) {
+			length = parse_size(argv[++i]);
+		} else if (strcmp(a, "-t") == 0) {
+			min_time = atof(argv[++i]);
+		} else if (strcmp(a, "-r") == 0) {
+			n_runs = atoi(argv[++i]);
+			runs_set = 1;
+			if (n_runs < 1 || n_runs > MAX_RUNS) {
+				fprintf(stderr, "Error: runs must be in [1, %d]\n",
+					MAX_RUNS);
+				return 1;
+			}
+		} else if (strcmp(a, "-c") == 0) {
+			baseline_file = argv[++i];
+		} else if (strcmp(a, "-T") == 0) {
+			tolerance = atof(argv[++i]) / 100;
+		} else if (strcmp(a, "-s") == 0) {
+			const char *p = argv[++i];
+			for (n_sizes = 0; p != NULL; n_sizes++) {
+				if (n_sizes == MAX_SIZES) {
+					fprintf(stderr, "Error: too many sizes\n");
+					return 1;
+				}
+				sizes[n_sizes] = parse_size(p);
+				p = strchr(p, ',');
+				if (p)
+					p++;
+			}
+			sizes_set = 1;
+		} else {
+			usage(argv[0]);
+			fprintf(stderr, "Error: invalid flag %s\n", a);
+			return 1;
+		}
+	}
+
+	// Results that may be compared later need their variance
+	if (!runs_set && (json_file || baseline_file))
+		n_runs = 5;
+
+	// Baseline, and its sizes unless -s is given
+	if (baseline_file) {
+		size_t b;
+
+		n_baseline = load_baseline(baseline_file, &baseline,
+					   &baseline_names);
+		if (n_baseline == 0) {
+			fprintf(stderr, "Error: no result in %s\n", baseline_file);
+			return 1;
+		}
+		if (!sizes_set)
+			n_sizes = 0;
+		for (b = 0; b < n_baseline && !sizes_set; b++) {
+			for (j = 0; j < n_sizes && sizes[j] != baseline[b].size; j++)
+				;
+			if (j < n_sizes)
+				continue;
+			if (n_sizes == MAX_SIZES) {
+				fprintf(stderr, "Error: too many sizes\n");
+				return 1;
+			}
+			sizes[n_sizes++] = baseline[b].size;
+		}
+	}
+
+	// Inputs
+	if (corpus_dir)
+		n_inputs = load_corpus(inputs, n_inputs, corpus_dir);
+	for (k = 0; k < (int)N_GENERATORS; k++) {
+		const char *name = generators[k].name;
+		const char *p = gen_list;
+		uint8_t *data;
+
+		// Select by name in the comma separated list
+		if (p != NULL) {
+			size_t len = strlen(name);
+			while ((p = strstr(p, name)) != NULL &&
+			       !((p == gen_list || p[-1] == ',') &&
+				 (p[len] == 0 || p[len] == ',')))
+				p++;
+			if (p == NULL)
+				continue;
+		}
+		data = xmalloc(length);
+		generators[k].gen(data, length);
+		n_inputs = add_input(inputs, n_inputs, name, data, length);
+	}
+	if (n_inputs == 0) {
+		fprintf(stderr, "Error: no input\n");
+		return 1;
+	}
+
+	{
+		size_t s1 = lzfse_encode_scratch_size(), s2 = lzfse_decode_scratch_size();
+		size_t s3 = lzvn_encode_scratch_size(), s4 = lzvn_decode_scratch_size();
+		size_t m = s1 > s2 ? s1 : s2;
+		m = m > s3 ? m : s3;
+		m = m > s4 ? m : s4;
+		scratch = xmalloc(m);
+	}
+	results = xmalloc((size_t)n_inputs * n_sizes * N_CODECS * sizeof(*results));
+
+	// The table goes to stderr when the JSON goes to stdout
+	table = (json_file && strcmp(json_file, "-") == 0) ? stderr : stdout;
+	print_header(table);
+	for (i = 0; i < n_inputs; i++)
+		for (j = 0; j < n_sizes; j++)
+			for (k = 0; k < N_CODECS; k++) {
+				bench_one(&inputs[i], sizes[j], k, scratch,
+					  &results[n_results]);
+				print_result(table, &results[n_results++]);
+			}
+
+	if (json_file) {
+		FILE *f = strcmp(json_file, "-") == 0 ? stdout : fopen(json_file, "w");
+		if (f == NULL) {
+			perror(json_file);
+			return 1;
+		}
+		write_json(f, results, n_results);
+		if (f != stdout && fclose(f) != 0) {
+			perror(json_file);
+			return 1;
+		}
+	}
+
+	if (baseline) {
+		regressions = compare(table, results, n_results, baseline,
+				      n_baseline, tolerance);
+		free(baseline_names);
+		free(baseline);
+	}
+
+	for (i = 0; i < n_inputs; i++)
+		free(inputs[i].data);
+	free(inputs);
+	free(results);
+	free(scratch);
+	return regressions ? 2 : 0;
+}
@@ -0,0 +1,200 @@
+/*
+Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:  
+
+1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+    in the documentation and/or other materials provided with the distribution.
+
+3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// LZFSE page cluster API
+
+#ifdef __KERNEL__
+#include <linux/module.h>
+#endif
+
+#include "lzfse.h"
+#include "lzfse_internal.h"
+
+size_t lzfse_cluster_encode_scratch_size() {
+  return lzfse_encode_scratch_size();
+}
+
+size_t lzfse_cluster_decode_scratch_size(size_t page_size,
+                                         size_t restart_interval) {
+  //  Decoder state, followed by room for the pages of a group decoded before
+  //  the requested one
+  return lzfse_decode_scratch_size() + page_size * restart_interval;
+}
+
+size_t lzfse_cluster_encode(uint8_t *dst_buffer, size_t dst_size,
+                            const uint8_t *src_buffer, size_t n_pages,
+                            size_t page_size, size_t restart_interval,
+                            void *scratch_buffer) {
+  lzfse_cluster_header header;
+  size_t n_groups, table_size, g;
+  uint8_t *table;
+  uint8_t *dst;
+
+  if (n_pages == 0 || page_size == 0 || restart_interval == 0 ||
+      n_pages > U32_MAX || page_size > U32_MAX ||
+      restart_interval > U32_MAX || n_pages * page_size / n_pages != page_size)
+    return 0; // invalid parameters
+  if (restart_interval > n_pages)
+    restart_interval = n_pages;
+  n_groups = (n_pages + restart_interval - 1) / restart_interval;
+  table_size = 4 * (n_groups + 1);
+  if (dst_size < sizeof(header) + table_size)
+    return 0; // DST full
+
+  header.magic = LZFSE_CLUSTER_MAGIC;
+  header.n_pages = (uint32_t)n_pages;
+  header.page_size = (uint32_t)page_size;
+  header.restart_interval = (uint32_t)restart_interval;
+  memcpy(dst_buffer, &header, sizeof(header));
+  table = dst_buffer + sizeof(header);
+  dst = table + table_size;
+
+  for (g = 0; g < n_groups; g++) {
+    size_t first = g * restart_interval;
+    size_t n = n_pages - first < restart_interval ? n_pages - first
+                                                  : restart_interval;
+    size_t sz;
+
+    store4(table + 4 * g, (uint32_t)(dst - (table + table_size)));
+    sz = lzfse_encode_buffer(dst, dst_buffer + dst_size - dst,
+                             src_buffer + first * page_size, n * page_size,
+                             scratch_buffer);
+    if (sz == 0 || dst - (table + table_size) + sz > U32_MAX)
+      return 0; // DST full
+    dst += sz;
+  }
+  store4(table + 4 * n_groups, (uint32_t)(dst - (table + table_size)));
+
+  return dst - dst_buffer;
+}
+
+//  Check the cluster header and offset table at SRC_BUFFER, and return the
+//  header in *HEADER and the start of the group streams in *STREAMS.
+//  Return 0 if the cluster is valid, and -1 otherwise.
+static int lzfse_cluster_parse(const uint8_t *src_buffer, size_t src_size,
+                               lzfse_cluster_header *header,
+                               const uint8_t **streams) {
+  size_t n_groups, table_size, g;
+
+  if (src_size < sizeof(*header))
+    return -1;
+  memcpy(header, src_buffer, sizeof(*header));
+  if (header->magic != LZFSE_CLUSTER_MAGIC || header->n_pages == 0 ||
+      header->page_size == 0 || header->restart_interval == 0 ||
+      header->restart_interval > header->n_pages)
+    return -1;
+  n_groups = ((size_t)header->n_pages + header->restart_interval - 1) /
+             header->restart_interval;
+  table_size = 4 * (n_groups + 1);
+  if (src_size - sizeof(*header) < table_size)
+    return -1;
+  *streams = src_buffer + sizeof(*header) + table_size;
+
+  //  Offsets must be increasing and end inside SRC
+  for (g = 0; g < n_groups; g++) {
+    const uint8_t *table = src_buffer + sizeof(*header);
+    if (load4(table + 4 * g) > load4(table + 4 * (g + 1)))
+      return -1;
+  }
+  if (load4(src_buffer + sizeof(*header) + 4 * n_groups) >
+      src_size - sizeof(*header) - table_size)
+    return -1;
+  return 0;
+}
+
+size_t lzfse_cluster_decode(uint8_t *dst_buffer, size_t dst_size,
+                            const uint8_t *src_buffer, size_t src_size,
+                            void *scratch_buffer) {
+  lzfse_cluster_header header;
+  const uint8_t *streams;
+  const uint8_t *table = src_buffer + sizeof(header);
+  size_t total, g, n_groups;
+
+  if (lzfse_cluster_parse(src_buffer, src_size, &header, &streams) != 0)
+    return 0;
+  total = (size_t)header.n_pages * header.page_size;
+  if (total > dst_size)
+    return 0; // DST too small
+  n_groups = ((size_t)header.n_pages + header.restart_interval - 1) /
+             header.restart_interval;
+
+  for (g = 0; g < n_groups; g++) {
+    size_t first = g * header.restart_interval;
+    size_t n = header.n_pages - first < header.restart_interval
+                   ? header.n_pages - first
+                   : header.restart_interval;
+    uint32_t begin = load4(table + 4 * g);
+    uint32_t end = load4(table + 4 * (g + 1));
+    size_t group_size = n * header.page_size;
+    uint8_t *dst = dst_buffer + first * header.page_size;
+
+    if (lzfse_decode_buffer(dst, group_size, streams + begin, end - begin,
+                            scratch_buffer) != group_size ||
+        lzfse_decoded_size(streams + begin, end - begin) != group_size)
+      return 0; // invalid group
+  }
+  return total;
+}
+
+int lzfse_cluster_decode_page(uint8_t *page, size_t page_size, size_t index,
+                              const uint8_t *src_buffer, size_t src_size,
+                              void *scratch_buffer, size_t restart_interval) {
+  lzfse_cluster_header header;
+  const uint8_t *streams;
+  const uint8_t *table = src_buffer + sizeof(header);
+  uint8_t *history = (uint8_t *)scratch_buffer + lzfse_decode_scratch_size();
+  size_t g, j, offset;
+  uint32_t begin, end;
+
+  if (lzfse_cluster_parse(src_buffer, src_size, &header, &streams) != 0 ||
+      index >= header.n_pages)
+    return -1;
+  //  The header decides how much is decoded: it must fit in PAGE and in the
+  //  history area the scratch buffer was sized for
+  if (header.page_size != page_size ||
+      header.restart_interval > restart_interval)
+    return -1;
+  g = index / header.restart_interval;
+  j = index % header.restart_interval;
+  begin = load4(table + 4 * g);
+  end = load4(table + 4 * (g + 1));
+  offset = j * header.page_size;
+
+  //  The first page of a group is decoded straight to PAGE, stopping when it
+  //  is full. Other pages need the preceding pages of their group as history.
+  if (j == 0)
+    return lzfse_decode_buffer(page, header.page_size, streams + begin,
+                               end - begin, scratch_buffer) == header.page_size
+               ? 0
+               : -1;
+  if (lzfse_decode_range(history, offset, header.page_size, streams + begin,
+                         end - begin, scratch_buffer) != header.page_size)
+    return -1;
+  memcpy(page, history + offset, header.page_size);
+  return 0;
+}
+
+EXPORT_SYMBOL(lzfse_cluster_encode_scratch_size);
+EXPORT_SYMBOL(lzfse_cluster_encode);
+EXPORT_SYMBOL(lzfse_cluster_decode_scratch_size);
+EXPORT_SYMBOL(lzfse_cluster_decode);
+EXPORT_SYMBOL(lzfse_cluster_decode_page);
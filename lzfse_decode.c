@@ -21,7 +21,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 
 // LZFSE decode API
 
-#if __linux__
+#ifdef __KERNEL__
 #include <linux/module.h>
 #endif
 
@@ -30,6 +30,66 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 
 size_t lzfse_decode_scratch_size() { return sizeof(lzfse_decoder_state); }
 
+//  Point the decoder at a new source/destination pair, rewind it to the start
+//  of a stream, and clear the decoding mode flags. Block decoder state
+//  (including the cached FSE decoder tables) is left untouched.
+static void lzfse_decode_reset(lzfse_decoder_state *s, uint8_t *dst_buffer,
+                               size_t dst_size, const uint8_t *src_buffer,
+                               size_t src_size) {
+  s->src = src_buffer;
+  s->src_begin = src_buffer;
+  s->src_end = s->src + src_size;
+  s->dst = dst_buffer;
+  s->dst_begin = dst_buffer;
+  s->dst_end = dst_buffer + dst_size;
+  s->end_of_stream = 0;
+  s->block_magic = LZFSE_NO_BLOCK_MAGIC;
+  s->trusted = 0;
+  s->in_place = 0;
+  s->validate = 0;
+  s->validated_bytes = 0;
+  memset(s->n_blocks, 0x00, sizeof(s->n_blocks));
+}
+
+//  Add a call that ran the decoder on S to the statistics: the input it
+//  consumed, the BYTES_OUT bytes it wrote, its time since T, how it ended
+//  (STATUS), and the blocks it started.
+static void lzfse_decode_account(const lzfse_decoder_state *s,
+                                 size_t bytes_out, int status, uint64_t t) {
+  int i;
+
+  LZFSE_STAT_INC(decode_calls);
+  LZFSE_STAT_ADD(decode_bytes_in, s->src - s->src_begin);
+  LZFSE_STAT_ADD(decode_bytes_out, bytes_out);
+  LZFSE_STAT_ADD(decode_ns, LZFSE_STAT_TIME() - t);
+  if (status == LZFSE_STATUS_DST_FULL)
+    LZFSE_STAT_INC(decode_dst_full);
+  else if (status != LZFSE_STATUS_OK)
+    LZFSE_STAT_INC(decode_errors);
+  for (i = 0; i < LZFSE_STAT_BLOCK_TYPES; i++)
+    LZFSE_STAT_ADD(decode_blocks[i], s->n_blocks[i]);
+}
+
+//  Run the decoder on an initialized state and map its status to a size.
+static size_t lzfse_decode_run(lzfse_decoder_state *s, uint8_t *dst_buffer,
+                               size_t dst_size) {
+  uint64_t t = LZFSE_STAT_TIME();
+  int status;
+  size_t ret;
+
+  trace_lzfse_decode_enter((size_t)(s->src_end - s->src_begin), dst_size);
+  status = lzfse_decode(s);
+  if (status == LZFSE_STATUS_DST_FULL)
+    ret = dst_size;
+  else if (status == LZFSE_STATUS_OK)
+    ret = (size_t)(s->dst - dst_buffer); // bytes written
+  else
+    ret = 0; // failed
+  trace_lzfse_decode_exit((size_t)(s->src_end - s->src_begin), ret, status);
+  lzfse_decode_account(s, (size_t)(s->dst - dst_buffer), status, t);
+  return ret;
+}
+
 size_t lzfse_decode_buffer(uint8_t *dst_buffer,
                          size_t dst_size, const uint8_t *src_buffer,
                          size_t src_size, void *scratch_buffer) {
@@ -37,23 +97,352 @@ size_t lzfse_decode_buffer(uint8_t *dst_buffer,
   memset(s, 0x00, sizeof(*s));
 
   // Initialize state
+  lzfse_decode_reset(s, dst_buffer, dst_size, src_buffer, src_size);
+
+  // Decode
+  return lzfse_decode_run(s, dst_buffer, dst_size);
+}
+
+void lzfse_decode_scratch_init(void *scratch_buffer) {
+  memset(scratch_buffer, 0x00, sizeof(lzfse_decoder_state));
+}
+
+size_t lzfse_decode_buffer_cached(uint8_t *dst_buffer, size_t dst_size,
+                                  const uint8_t *src_buffer, size_t src_size,
+                                  void *scratch_buffer) {
+  lzfse_decoder_state *s = (lzfse_decoder_state *)scratch_buffer;
+
+  // Keep the block state from previous calls, so FSE decoder tables built
+  // for an earlier stream can be reused
+  lzfse_decode_reset(s, dst_buffer, dst_size, src_buffer, src_size);
+
+  return lzfse_decode_run(s, dst_buffer, dst_size);
+}
+
+size_t lzfse_decode_buffer_trusted(uint8_t *dst_buffer, size_t dst_size,
+                                   const uint8_t *src_buffer, size_t src_size,
+                                   void *scratch_buffer) {
+  lzfse_decoder_state *s = (lzfse_decoder_state *)scratch_buffer;
+  memset(s, 0x00, sizeof(*s));
+
+  lzfse_decode_reset(s, dst_buffer, dst_size, src_buffer, src_size);
+  s->trusted = 1;
+
+  return lzfse_decode_run(s, dst_buffer, dst_size);
+}
+
+size_t lzfse_decoded_size(const uint8_t *src_buffer, size_t src_size) {
+  const uint8_t *src = src_buffer;
+  const uint8_t *src_end = src_buffer + src_size;
+  size_t total = 0;
+
+  while (1) {
+    lzfse_block_info info;
+    if (lzfse_decode_block_info(src, src_end - src, &info) != LZFSE_STATUS_OK)
+      return 0; // malformed or truncated
+    if (info.magic == LZFSE_ENDOFSTREAM_BLOCK_MAGIC)
+      return total;
+
+    // Skip the block, and make sure it is entirely present
+    size_t block_size = (size_t)info.header_size + info.n_payload_bytes;
+    if (block_size > (size_t)(src_end - src))
+      return 0; // truncated
+    src += block_size;
+
+    if (total + info.n_raw_bytes < total)
+      return 0; // overflow
+    total += info.n_raw_bytes;
+  }
+}
+
+//  Extra bytes the LZFSE and LZVN block decoders may write past the end of
+//  the current block with their wide copies.
+#define LZFSE_DECODE_INPLACE_SLACK 32
+
+//  Walk the block headers of a stream, and compute its decompressed size and
+//  the minimum size of a buffer holding both the output and, at its end, the
+//  stream, such that decoding never overwrites unread source bytes.
+//  Return 0 on success, and -1 if the stream is malformed or truncated.
+static int lzfse_decode_inplace_layout(const uint8_t *src_buffer,
+                                       size_t src_size, size_t *decoded_size,
+                                       size_t *buffer_size) {
+  const uint8_t *src = src_buffer;
+  const uint8_t *src_end = src_buffer + src_size;
+  size_t w = 0;           // output bytes before the current block
+  size_t need = src_size; // minimum buffer size so far
+
+  while (1) {
+    lzfse_block_info info;
+    if (lzfse_decode_block_info(src, src_end - src, &info) != LZFSE_STATUS_OK)
+      return -1; // malformed or truncated
+    if (info.magic == LZFSE_ENDOFSTREAM_BLOCK_MAGIC)
+      break;
+    size_t block_size = (size_t)info.header_size + info.n_payload_bytes;
+    if (block_size > (size_t)(src_end - src))
+      return -1; // truncated
+
+    // Offset in the stream of the first byte still unread while the block
+    // is written, and end of the region written by the block
+    size_t unread = (src - src_buffer) + info.header_size;
+    size_t written = w;
+    if (info.magic == LZFSE_COMPRESSEDV1_BLOCK_MAGIC ||
+        info.magic == LZFSE_COMPRESSEDV2_BLOCK_MAGIC)
+      unread += info.n_literal_payload_bytes;
+    if (info.magic != LZFSE_UNCOMPRESSED_BLOCK_MAGIC)
+      written += (size_t)info.n_raw_bytes + LZFSE_DECODE_INPLACE_SLACK;
+
+    // The stream starts at BUFFER_SIZE - SRC_SIZE, so we need:
+    // WRITTEN <= BUFFER_SIZE - SRC_SIZE + UNREAD
+    if (written + (src_size - unread) > need)
+      need = written + (src_size - unread);
+
+    if (w + info.n_raw_bytes < w)
+      return -1; // overflow
+    w += info.n_raw_bytes;
+    src += block_size;
+  }
+
+  if (w > need)
+    need = w;
+  *decoded_size = w;
+  *buffer_size = need;
+  return 0;
+}
+
+size_t lzfse_decode_inplace_margin(const uint8_t *src_buffer,
+                                   size_t src_size) {
+  size_t decoded_size, buffer_size;
+  if (lzfse_decode_inplace_layout(src_buffer, src_size, &decoded_size,
+                                  &buffer_size) != 0)
+    return 0; // failed
+  // Never 0 for a valid stream: the buffer holds at least the whole stream,
+  // which is larger than its output unless some block is compressed, and
+  // then the slack applies
+  return buffer_size - decoded_size;
+}
+
+size_t lzfse_decode_buffer_inplace(uint8_t *buffer, size_t buffer_size,
+                                   size_t src_size, void *scratch_buffer) {
+  lzfse_decoder_state *s = (lzfse_decoder_state *)scratch_buffer;
+  const uint8_t *src_buffer = buffer + buffer_size - src_size;
+  uint64_t t = LZFSE_STAT_TIME();
+  size_t decoded_size, needed_size;
+
+  if (src_size > buffer_size ||
+      lzfse_decode_inplace_layout(src_buffer, src_size, &decoded_size,
+                                  &needed_size) != 0 ||
+      needed_size > buffer_size)
+    return 0; // invalid stream, or not enough margin
+
+  memset(s, 0x00, sizeof(*s));
+  lzfse_decode_reset(s, buffer, buffer_size, src_buffer, src_size);
+  s->in_place = 1;
+
+  int status = lzfse_decode(s);
+  lzfse_decode_account(s, (size_t)(s->dst - buffer), status, t);
+  if (status != LZFSE_STATUS_OK || (size_t)(s->dst - buffer) != decoded_size)
+    return 0; // failed
+  return decoded_size;
+}
+
+size_t lzfse_validate_buffer(const uint8_t *src_buffer, size_t src_size,
+                             void *scratch_buffer) {
+  lzfse_decoder_state *s = (lzfse_decoder_state *)scratch_buffer;
+  memset(s, 0x00, sizeof(*s));
+
+  // No destination buffer: dst stays NULL and is never used
   s->src = src_buffer;
   s->src_begin = src_buffer;
-  s->src_end = s->src + src_size;
-  s->dst = dst_buffer;
-  s->dst_begin = dst_buffer;
-  s->dst_end = dst_buffer + dst_size;
+  s->src_end = src_buffer + src_size;
+  s->block_magic = LZFSE_NO_BLOCK_MAGIC;
+  s->validate = 1;
 
-  // Decode
+  if (lzfse_decode(s) != LZFSE_STATUS_OK || !s->end_of_stream)
+    return 0; // invalid or truncated
+  return s->validated_bytes;
+}
+
+//  Return 1 if a block of type MAGIC references output of previous blocks.
+static inline int lzfse_block_has_matches(uint32_t magic) {
+  return magic != LZFSE_UNCOMPRESSED_BLOCK_MAGIC;
+}
+
+size_t lzfse_decode_range(uint8_t *dst_buffer, size_t offset, size_t length,
+                          const uint8_t *src_buffer, size_t src_size,
+                          void *scratch_buffer) {
+  lzfse_decoder_state *s = (lzfse_decoder_state *)scratch_buffer;
+  const uint8_t *src_end = src_buffer + src_size;
+  const uint8_t *p;
+  lzfse_block_info info;
+  uint64_t t = LZFSE_STAT_TIME();
+  size_t w;
+
+  if (length == 0 || offset + length < offset)
+    return 0; // empty or invalid range
+
+  //  Every block starting before OFFSET + LENGTH is decoded, and compressed
+  //  blocks need up to LZFSE_ENCODE_MAX_D_VALUE bytes of history before
+  //  them. Compute the output position HISTORY from which bytes are needed:
+  //  compressed blocks ending after it must be decoded too, and in turn need
+  //  history, so iterate until HISTORY no longer moves.
+  size_t history = offset;
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (p = src_buffer, w = 0; w < offset + length;
+         p += info.header_size + info.n_payload_bytes) {
+      if (lzfse_decode_block_info(p, src_end - p, &info) != LZFSE_STATUS_OK)
+        return 0; // malformed or truncated
+      if (info.magic == LZFSE_ENDOFSTREAM_BLOCK_MAGIC ||
+          (size_t)info.header_size + info.n_payload_bytes >
+              (size_t)(src_end - p))
+        break;
+      if (w + info.n_raw_bytes > history &&
+          lzfse_block_has_matches(info.magic)) {
+        size_t h = (w > LZFSE_ENCODE_MAX_D_VALUE)
+                       ? w - LZFSE_ENCODE_MAX_D_VALUE
+                       : 0;
+        if (h < history) {
+          history = h;
+          changed = 1;
+        }
+      }
+      w += info.n_raw_bytes;
+    }
+  }
+
+  //  Skip all the blocks ending before HISTORY
+  for (p = src_buffer, w = 0;; p += info.header_size + info.n_payload_bytes) {
+    if (lzfse_decode_block_info(p, src_end - p, &info) != LZFSE_STATUS_OK)
+      return 0; // malformed or truncated
+    if (info.magic == LZFSE_ENDOFSTREAM_BLOCK_MAGIC ||
+        w + info.n_raw_bytes > history)
+      break;
+    if ((size_t)info.header_size + info.n_payload_bytes > (size_t)(src_end - p))
+      return 0; // truncated
+    w += info.n_raw_bytes;
+  }
+  if (w > offset)
+    return 0; // stream ends before OFFSET
+
+  //  Decode from there, stopping at the end of the range
+  memset(s, 0x00, sizeof(*s));
+  lzfse_decode_reset(s, dst_buffer, offset + length, p, src_end - p);
+  s->dst = dst_buffer + w;
   int status = lzfse_decode(s);
-  if (status == LZFSE_STATUS_DST_FULL)
-    return dst_size;
-  if (status != LZFSE_STATUS_OK)
-    return 0;                           // failed
-  return (size_t)(s->dst - dst_buffer); // bytes written
+  lzfse_decode_account(s, (size_t)(s->dst - (dst_buffer + w)), status, t);
+  if (status != LZFSE_STATUS_OK && status != LZFSE_STATUS_DST_FULL)
+    return 0; // failed
+  if ((size_t)(s->dst - dst_buffer) <= offset)
+    return 0; // stream ends before OFFSET
+  return (size_t)(s->dst - dst_buffer) - offset;
+}
+
+size_t lzfse_decode_segments_scratch_size() {
+  return sizeof(lzfse_decoder_state) + LZFSE_SEGMENT_WINDOW_SIZE;
+}
+
+//  Copy N bytes from SRC to segments SEG, from segment *I at offset *OFF, and
+//  advance (*I, *OFF). The segments must have room for at least N more bytes.
+static void lzfse_segments_scatter(const lzfse_segment *seg, size_t *i,
+                                   size_t *off, const uint8_t *src, size_t n) {
+  while (n > 0) {
+    size_t k = seg[*i].size - *off;
+    if (k > n)
+      k = n;
+    memcpy((uint8_t *)seg[*i].base + *off, src, k);
+    src += k;
+    n -= k;
+    *off += k;
+    if (*off == seg[*i].size) {
+      (*i)++;
+      *off = 0;
+    }
+  }
+}
+
+size_t lzfse_decode_segments(const lzfse_segment *dst, size_t n_dst,
+                             const uint8_t *src_buffer, size_t src_size,
+                             void *scratch_buffer) {
+  lzfse_decoder_state *s = (lzfse_decoder_state *)scratch_buffer;
+  uint8_t *window = (uint8_t *)scratch_buffer + sizeof(lzfse_decoder_state);
+  uint8_t *window_end = window + LZFSE_SEGMENT_WINDOW_SIZE;
+  uint64_t t = LZFSE_STAT_TIME();
+  size_t dst_size = 0;
+  size_t written = 0;
+  size_t i = 0, off = 0;
+  size_t k, ret;
+  int status;
+
+  for (k = 0; k < n_dst; k++)
+    dst_size += dst[k].size;
+
+  //  A single segment is already contiguous
+  if (n_dst == 1)
+    return lzfse_decode_buffer(dst[0].base, dst_size, src_buffer, src_size,
+                               scratch_buffer);
+
+  memset(s, 0x00, sizeof(*s));
+  lzfse_decode_reset(s, window,
+                     dst_size < LZFSE_SEGMENT_WINDOW_SIZE
+                         ? dst_size
+                         : LZFSE_SEGMENT_WINDOW_SIZE,
+                     src_buffer, src_size);
+
+  //  Decode into the window until it is full, copy the new output to the
+  //  segments, then keep the last LZFSE_SEGMENT_HISTORY_SIZE bytes at the
+  //  start of the window as history for the matches that follow. The decoder
+  //  state only refers to the output through s->dst, so it can be moved.
+  while (1) {
+    uint8_t *flushed = s->dst;
+    size_t n;
+
+    status = lzfse_decode(s);
+    n = s->dst - flushed;
+    if (status != LZFSE_STATUS_OK && status != LZFSE_STATUS_DST_FULL) {
+      ret = 0; // failed
+      break;
+    }
+    lzfse_segments_scatter(dst, &i, &off, flushed, n);
+    written += n;
+    if (status == LZFSE_STATUS_OK) {
+      ret = written;
+      break;
+    }
+    if (written == dst_size) {
+      ret = dst_size; // DST full, as lzfse_decode_buffer
+      break;
+    }
+    if (n == 0 && s->dst - window <= LZFSE_SEGMENT_HISTORY_SIZE) {
+      status = LZFSE_STATUS_ERROR;
+      ret = 0; // no progress
+      break;
+    }
+
+    if (s->dst - window > LZFSE_SEGMENT_HISTORY_SIZE) {
+      memmove(window, s->dst - LZFSE_SEGMENT_HISTORY_SIZE,
+              LZFSE_SEGMENT_HISTORY_SIZE);
+      s->dst = window + LZFSE_SEGMENT_HISTORY_SIZE;
+    }
+    s->dst_end = (size_t)(window_end - s->dst) < dst_size - written
+                     ? window_end
+                     : s->dst + (dst_size - written);
+  }
+  lzfse_decode_account(s, written, status, t);
+  return ret;
 }
 
 EXPORT_SYMBOL(lzfse_decode_scratch_size);
 EXPORT_SYMBOL(lzfse_decode_buffer);
+EXPORT_SYMBOL(lzfse_decode_scratch_init);
+EXPORT_SYMBOL(lzfse_decode_buffer_cached);
+EXPORT_SYMBOL(lzfse_decode_buffer_trusted);
+EXPORT_SYMBOL(lzfse_decoded_size);
+EXPORT_SYMBOL(lzfse_decode_inplace_margin);
+EXPORT_SYMBOL(lzfse_decode_buffer_inplace);
+EXPORT_SYMBOL(lzfse_validate_buffer);
+EXPORT_SYMBOL(lzfse_decode_range);
+EXPORT_SYMBOL(lzfse_decode_segments_scratch_size);
+EXPORT_SYMBOL(lzfse_decode_segments);
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("Lzfse Decompressor");
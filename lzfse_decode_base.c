@@ -19,11 +19,12 @@ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABI
 ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#if __linux__
+#ifdef __KERNEL__
 #include <linux/module.h>
 #endif
 
 #include "lzfse_internal.h"
+#include "lzfse_decode_tables.h"
 #include "lzvn.h"
 
 /*! @abstract Decode an entry value from next bits of stream.
@@ -111,43 +112,94 @@ static inline int lzfse_decode_v1(lzfse_compressed_block_header_v1 *out,
   const uint8_t *src = &(in->freq[0]);
   const uint8_t *src_end =
       (const uint8_t *)in + get_field(v2, 0, 32); // first byte after header
-  uint32_t accum = 0;
+  uint64_t accum = 0;
   int accum_nbits = 0;
+  const int n_symbols = LZFSE_ENCODE_L_SYMBOLS + LZFSE_ENCODE_M_SYMBOLS +
+                        LZFSE_ENCODE_D_SYMBOLS + LZFSE_ENCODE_LITERAL_SYMBOLS;
 
   // No freq tables?
   if (src_end == src)
     return 0; // OK, freq tables were omitted
-  int i;
-  for (i = 0; i < LZFSE_ENCODE_L_SYMBOLS + LZFSE_ENCODE_M_SYMBOLS +
-                          LZFSE_ENCODE_D_SYMBOLS + LZFSE_ENCODE_LITERAL_SYMBOLS;
-       i++) {
-    // Refill accum, one byte at a time, until we reach end of header, or accum
-    // is full
-    while (src < src_end && accum_nbits + 8 <= 32) {
-      accum |= (uint32_t)(*src) << accum_nbits;
-      accum_nbits += 8;
-      src++;
+  int i = 0;
+  while (i < n_symbols) {
+    // Refill accum: 8 bytes at once while they are all inside the header,
+    // then one byte at a time until the end of header
+    if (src_end - src >= 8) {
+      accum |= load8(src) << accum_nbits;
+      src += (63 - accum_nbits) >> 3;
+      accum_nbits |= 56;
+    } else {
+      while (src < src_end && accum_nbits + 8 <= 64) {
+        accum |= (uint64_t)(*src) << accum_nbits;
+        accum_nbits += 8;
+        src++;
+      }
     }
 
-    // Decode and store value
-    int nbits = 0;
-    dst[i] = lzfse_decode_v1_freq_value(accum, &nbits);
-
-    if (nbits > accum_nbits)
-      return -1; // failed
+    // Decode values until accum may no longer hold a full 14-bit code
+    do {
+      uint32_t e = lzfse_freq_multi_table
+          [accum & ((1 << LZFSE_FREQ_MULTI_TABLE_BITS) - 1)];
+      int count = (e >> 16) & 7;
+      int nbits;
+      if (count != 0 && i + count <= n_symbols) {
+        // Several short codes at once
+        nbits = (e >> 24) & 15;
+        if (nbits > accum_nbits)
+          return -1; // failed
+        int k;
+        for (k = 0; k < count; k++)
+          dst[i + k] = (e >> (3 * k)) & 7;
+        i += count;
+      } else {
+        // Long code, or last values of the table
+        dst[i] = lzfse_decode_v1_freq_value((uint32_t)accum, &nbits);
+        if (nbits > accum_nbits)
+          return -1; // failed
+        i++;
+      }
 
-    // Consume nbits bits
-    accum >>= nbits;
-    accum_nbits -= nbits;
+      // Consume nbits bits
+      accum >>= nbits;
+      accum_nbits -= nbits;
+    } while (accum_nbits >= 14 && i < n_symbols);
   }
 
-  if (accum_nbits >= 8 || src != src_end)
+  if (accum_nbits + 8 * (src_end - src) >= 8)
     return -1; // we need to end up exactly at the end of header, with less than
-               // 8 bits in accumulator
+               // 8 bits left unread
 
   return 0;
 }
 
+/*! @abstract Hash a normalized frequency table (FNV-1a over the 16-bit
+ *  values). Never returns 0, which marks an empty cache entry. */
+static inline uint32_t lzfse_freq_hash(const uint16_t *freq, int nsymbols) {
+  uint32_t h = 2166136261U;
+  int i;
+  for (i = 0; i < nsymbols; i++)
+    h = (h ^ freq[i]) * 16777619U;
+  return h ? h : 1;
+}
+
+/*! @abstract Check whether the decoder table last built from \p cached_freq
+ *  can be reused for \p freq. On a miss, \p cached_freq and \p *cached_hash
+ *  are updated to describe \p freq, and the caller must rebuild the table.
+ *  The hash rejects most mismatches; equal hashes are confirmed by comparing
+ *  the tables, so a collision can never select a wrong decoder table.
+ *  @return 1 on a hit, 0 on a miss. */
+static inline int lzfse_freq_cache_lookup(uint32_t *cached_hash,
+                                          uint16_t *cached_freq,
+                                          const uint16_t *freq, int nsymbols) {
+  uint32_t h = lzfse_freq_hash(freq, nsymbols);
+  if (h == *cached_hash &&
+      memcmp(cached_freq, freq, nsymbols * sizeof(uint16_t)) == 0)
+    return 1; // hit
+  *cached_hash = h;
+  memcpy(cached_freq, freq, nsymbols * sizeof(uint16_t));
+  return 0; // miss
+}
+
 static inline void copy(uint8_t *dst, const uint8_t *src, size_t length) {
   const uint8_t *dst_end = dst + length;
   do {
@@ -157,6 +209,58 @@ static inline void copy(uint8_t *dst, const uint8_t *src, size_t length) {
   } while (dst < dst_end);
 }
 
+//  Decode an entire LZFSE block for a trusted source, see
+//  lzfse_decode_buffer_trusted. The caller guarantees that the block has not
+//  been started yet, and that there are at least n_raw_bytes + 32 bytes of
+//  space in DST. The per-match checks of lzfse_decode_lmd are replaced by a
+//  single check of the literal, payload and output sizes at the end of the
+//  block.
+static int lzfse_decode_lmd_trusted(lzfse_decoder_state *s) {
+  lzfse_compressed_block_decoder_state *bs = &(s->compressed_lzfse_block_state);
+  fse_state l_state = bs->l_state;
+  fse_state m_state = bs->m_state;
+  fse_state d_state = bs->d_state;
+  fse_in_stream in = bs->lmd_in_stream;
+  const uint8_t *src = s->src + bs->lmd_in_buf;
+  const uint8_t *lit = bs->current_literal;
+  uint8_t *dst = s->dst;
+  uint8_t *dst_block = dst;
+  uint32_t symbols = bs->n_matches;
+  int32_t D = bs->d_value;
+
+  while (symbols > 0) {
+    fse_in_unchecked_flush(&in, &src);
+    int32_t L = fse_value_decode(&l_state, bs->l_decoder, &in);
+    fse_in_unchecked_flush2(&in, &src);
+    int32_t M = fse_value_decode(&m_state, bs->m_decoder, &in);
+    fse_in_unchecked_flush2(&in, &src);
+    int32_t new_d = fse_value_decode(&d_state, bs->d_decoder, &in);
+    D = new_d ? new_d : D;
+    symbols--;
+
+    copy(dst, lit, L);
+    dst += L;
+    lit += L;
+    if (D >= 8 || D >= M) {
+      copy(dst, dst - D, M);
+    } else {
+      size_t i;
+      for (i = 0; i < M; i++)
+        dst[i] = dst[i - D];
+    }
+    dst += M;
+  }
+
+  //  Block level checks: we must have stayed inside the LMD payload and the
+  //  literals of the block, and produced exactly the declared number of
+  //  bytes.
+  if (src < s->src || lit > bs->literals + bs->n_literals ||
+      (size_t)(dst - dst_block) != bs->n_raw_bytes)
+    return LZFSE_STATUS_ERROR;
+  s->dst = dst;
+  return LZFSE_STATUS_OK;
+}
+
 static int lzfse_decode_lmd(lzfse_decoder_state *s) {
   lzfse_compressed_block_decoder_state *bs = &(s->compressed_lzfse_block_state);
   fse_state l_state = bs->l_state;
@@ -191,6 +295,12 @@ static int lzfse_decode_lmd(lzfse_decoder_state *s) {
   if (L || M)
     goto ExecuteMatch;
 
+  //  Take the unchecked path for trusted sources, when the whole block fits
+  //  in DST with the usual 32 bytes of margin.
+  if (s->trusted && lit == bs->literals &&
+      (size_t)bs->n_raw_bytes + 32 <= (size_t)(s->dst_end - dst))
+    return lzfse_decode_lmd_trusted(s);
+
   while (symbols > 0) {
     int res;
     //  Decode the next L, M, D symbol from the input stream.
@@ -340,6 +450,165 @@ static int lzfse_decode_lmd(lzfse_decoder_state *s) {
   return LZFSE_STATUS_OK;
 }
 
+//  Validate the L, M, D stream of an entire LZFSE block, see
+//  lzfse_validate_buffer. Same decoding and checks as lzfse_decode_lmd, but
+//  literals and matches are not copied; the output position is tracked in
+//  s->validated_bytes.
+static int lzfse_validate_lmd(lzfse_decoder_state *s) {
+  lzfse_compressed_block_decoder_state *bs = &(s->compressed_lzfse_block_state);
+  fse_state l_state = bs->l_state;
+  fse_state m_state = bs->m_state;
+  fse_state d_state = bs->d_state;
+  fse_in_stream in = bs->lmd_in_stream;
+  const uint8_t *src_start = s->src_begin;
+  const uint8_t *src = s->src + bs->lmd_in_buf;
+  const uint8_t *lit = bs->current_literal;
+  uint32_t symbols = bs->n_matches;
+  int32_t D = bs->d_value;
+  size_t out = s->validated_bytes;
+
+  while (symbols > 0) {
+    if (fse_in_flush(&in, &src, src_start) != 0)
+      return LZFSE_STATUS_ERROR;
+    int32_t L = fse_value_decode(&l_state, bs->l_decoder, &in);
+    if ((lit + L) >= (bs->literals + LZFSE_LITERALS_PER_BLOCK + 64))
+      return LZFSE_STATUS_ERROR;
+    if (fse_in_flush2(&in, &src, src_start) != 0)
+      return LZFSE_STATUS_ERROR;
+    int32_t M = fse_value_decode(&m_state, bs->m_decoder, &in);
+    if (fse_in_flush2(&in, &src, src_start) != 0)
+      return LZFSE_STATUS_ERROR;
+    int32_t new_d = fse_value_decode(&d_state, bs->d_decoder, &in);
+    D = new_d ? new_d : D;
+    symbols--;
+
+    //  Same distance check as lzfse_decode_lmd, relative to the virtual
+    //  output position
+    if ((uint32_t)D > out + L)
+      return LZFSE_STATUS_ERROR;
+    lit += L;
+    out += L + M;
+  }
+
+  if (out - s->validated_bytes != bs->n_raw_bytes)
+    return LZFSE_STATUS_ERROR; // block size mismatch
+  s->validated_bytes = out;
+  return LZFSE_STATUS_OK;
+}
+
+int lzfse_decode_block_info(const uint8_t *src, size_t src_size,
+                            lzfse_block_info *info) {
+  memset(info, 0x00, sizeof(*info));
+  if (src_size < 4)
+    return LZFSE_STATUS_SRC_EMPTY; // SRC truncated
+  uint32_t magic = load4(src);
+  info->magic = magic;
+
+  switch (magic) {
+  case LZFSE_ENDOFSTREAM_BLOCK_MAGIC:
+    info->header_size = 4;
+    return LZFSE_STATUS_OK;
+
+  case LZFSE_UNCOMPRESSED_BLOCK_MAGIC:
+    if (src_size < sizeof(uncompressed_block_header))
+      return LZFSE_STATUS_SRC_EMPTY; // SRC truncated
+    info->header_size = sizeof(uncompressed_block_header);
+    info->n_raw_bytes =
+        load4(src + offsetof(uncompressed_block_header, n_raw_bytes));
+    info->n_payload_bytes = info->n_raw_bytes;
+    return LZFSE_STATUS_OK;
+
+  case LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC:
+    if (src_size < sizeof(lzvn_compressed_block_header))
+      return LZFSE_STATUS_SRC_EMPTY; // SRC truncated
+    info->header_size = sizeof(lzvn_compressed_block_header);
+    info->n_raw_bytes =
+        load4(src + offsetof(lzvn_compressed_block_header, n_raw_bytes));
+    info->n_payload_bytes =
+        load4(src + offsetof(lzvn_compressed_block_header, n_payload_bytes));
+    return LZFSE_STATUS_OK;
+
+  case LZFSE_COMPRESSEDV1_BLOCK_MAGIC:
+    if (src_size < sizeof(lzfse_compressed_block_header_v1))
+      return LZFSE_STATUS_SRC_EMPTY; // SRC truncated
+    info->header_size = sizeof(lzfse_compressed_block_header_v1);
+#define LOAD_V1_FIELD(F)                                                       \
+  load4(src + offsetof(lzfse_compressed_block_header_v1, F))
+    info->n_raw_bytes = LOAD_V1_FIELD(n_raw_bytes);
+    info->n_literals = LOAD_V1_FIELD(n_literals);
+    info->n_matches = LOAD_V1_FIELD(n_matches);
+    info->n_literal_payload_bytes = LOAD_V1_FIELD(n_literal_payload_bytes);
+    info->n_lmd_payload_bytes = LOAD_V1_FIELD(n_lmd_payload_bytes);
+    info->literal_bits = (int32_t)LOAD_V1_FIELD(literal_bits);
+    info->lmd_bits = (int32_t)LOAD_V1_FIELD(lmd_bits);
+#undef LOAD_V1_FIELD
+    break;
+
+  case LZFSE_COMPRESSEDV2_BLOCK_MAGIC: {
+    // Only the fixed part of the header is needed, the freq tables are
+    // skipped
+    if (src_size < offsetof(lzfse_compressed_block_header_v2, freq))
+      return LZFSE_STATUS_SRC_EMPTY; // SRC truncated
+    const lzfse_compressed_block_header_v2 *header2 =
+        (const lzfse_compressed_block_header_v2 *)src; // not aligned, OK
+    uint64_t v0 = header2->packed_fields[0];
+    uint64_t v1 = header2->packed_fields[1];
+    info->header_size = lzfse_decode_v2_header_size(header2);
+    if (info->header_size < offsetof(lzfse_compressed_block_header_v2, freq) ||
+        info->header_size > sizeof(lzfse_compressed_block_header_v2))
+      return LZFSE_STATUS_ERROR; // invalid header size
+    if (src_size < info->header_size)
+      return LZFSE_STATUS_SRC_EMPTY; // SRC truncated
+    info->n_raw_bytes = header2->n_raw_bytes;
+    info->n_literals = get_field(v0, 0, 20);
+    info->n_literal_payload_bytes = get_field(v0, 20, 20);
+    info->n_matches = get_field(v0, 40, 20);
+    info->literal_bits = (int)get_field(v0, 60, 3) - 7;
+    info->n_lmd_payload_bytes = get_field(v1, 40, 20);
+    info->lmd_bits = (int)get_field(v1, 60, 3) - 7;
+    break;
+  }
+
+  default:
+    return LZFSE_STATUS_ERROR; // bad magic
+  }
+
+  // LZFSE compressed blocks: payload is literals followed by L, M, D
+  info->n_payload_bytes =
+      info->n_literal_payload_bytes + info->n_lmd_payload_bytes;
+  if (info->n_literals > LZFSE_LITERALS_PER_BLOCK ||
+      info->n_matches > LZFSE_MATCHES_PER_BLOCK)
+    return LZFSE_STATUS_ERROR; // out of range
+  return LZFSE_STATUS_OK;
+}
+
+int lzfse_decode_block_freq(const uint8_t *src, size_t src_size,
+                            lzfse_block_freq *freq) {
+  lzfse_block_info info;
+  lzfse_compressed_block_header_v1 header1;
+
+  memset(freq, 0x00, sizeof(*freq));
+  int status = lzfse_decode_block_info(src, src_size, &info);
+  if (status != LZFSE_STATUS_OK)
+    return status;
+
+  if (info.magic == LZFSE_COMPRESSEDV2_BLOCK_MAGIC) {
+    if (lzfse_decode_v1(&header1,
+                        (const lzfse_compressed_block_header_v2 *)src) != 0)
+      return LZFSE_STATUS_ERROR; // failed
+  } else if (info.magic == LZFSE_COMPRESSEDV1_BLOCK_MAGIC) {
+    memcpy(&header1, src, sizeof(header1));
+  } else {
+    return LZFSE_STATUS_OK; // no freq tables
+  }
+
+  memcpy(freq->l_freq, header1.l_freq, sizeof(freq->l_freq));
+  memcpy(freq->m_freq, header1.m_freq, sizeof(freq->m_freq));
+  memcpy(freq->d_freq, header1.d_freq, sizeof(freq->d_freq));
+  memcpy(freq->literal_freq, header1.literal_freq, sizeof(freq->literal_freq));
+  return LZFSE_STATUS_OK;
+}
+
 int lzfse_decode(lzfse_decoder_state *s) {
   while (1) {
     // Are we inside a block?
@@ -353,6 +622,7 @@ int lzfse_decode(lzfse_decoder_state *s) {
       if (magic == LZFSE_ENDOFSTREAM_BLOCK_MAGIC) {
         s->src += 4;
         s->end_of_stream = 1;
+        s->n_blocks[LZFSE_STAT_BLOCK_ENDOFSTREAM]++;
         return LZFSE_STATUS_OK; // done
       }
 
@@ -365,6 +635,7 @@ int lzfse_decode(lzfse_decoder_state *s) {
             load4(s->src + offsetof(uncompressed_block_header, n_raw_bytes));
         s->src += sizeof(uncompressed_block_header);
         s->block_magic = magic;
+        s->n_blocks[LZFSE_STAT_BLOCK_UNCOMPRESSED]++;
         break;
       }
 
@@ -381,6 +652,7 @@ int lzfse_decode(lzfse_decoder_state *s) {
         bs->d_prev = 0;
         s->src += sizeof(lzvn_compressed_block_header);
         s->block_magic = magic;
+        s->n_blocks[LZFSE_STAT_BLOCK_LZVN]++;
         break;
       }
 
@@ -433,20 +705,33 @@ int lzfse_decode(lzfse_decoder_state *s) {
         // Setup state for compressed V1 block from header
         lzfse_compressed_block_decoder_state *bs =
             &(s->compressed_lzfse_block_state);
+        bs->n_raw_bytes = header1.n_raw_bytes;
+        bs->n_literals = header1.n_literals;
         bs->n_lmd_payload_bytes = header1.n_lmd_payload_bytes;
         bs->n_matches = header1.n_matches;
-        fse_init_decoder_table(LZFSE_ENCODE_LITERAL_STATES,
-                               LZFSE_ENCODE_LITERAL_SYMBOLS,
-                               header1.literal_freq, bs->literal_decoder);
-        fse_init_value_decoder_table(
-            LZFSE_ENCODE_L_STATES, LZFSE_ENCODE_L_SYMBOLS, header1.l_freq,
-            l_extra_bits, l_base_value, bs->l_decoder);
-        fse_init_value_decoder_table(
-            LZFSE_ENCODE_M_STATES, LZFSE_ENCODE_M_SYMBOLS, header1.m_freq,
-            m_extra_bits, m_base_value, bs->m_decoder);
-        fse_init_value_decoder_table(
-            LZFSE_ENCODE_D_STATES, LZFSE_ENCODE_D_SYMBOLS, header1.d_freq,
-            d_extra_bits, d_base_value, bs->d_decoder);
+        // Rebuild only the decoder tables whose frequencies changed since
+        // the previous block
+        if (!lzfse_freq_cache_lookup(&bs->literal_freq_hash, bs->literal_freq,
+                                     header1.literal_freq,
+                                     LZFSE_ENCODE_LITERAL_SYMBOLS))
+          fse_init_decoder_table(LZFSE_ENCODE_LITERAL_STATES,
+                                 LZFSE_ENCODE_LITERAL_SYMBOLS,
+                                 header1.literal_freq, bs->literal_decoder);
+        if (!lzfse_freq_cache_lookup(&bs->l_freq_hash, bs->l_freq,
+                                     header1.l_freq, LZFSE_ENCODE_L_SYMBOLS))
+          fse_init_value_decoder_table(
+              LZFSE_ENCODE_L_STATES, LZFSE_ENCODE_L_SYMBOLS, header1.l_freq,
+              l_extra_bits, l_base_value, bs->l_decoder);
+        if (!lzfse_freq_cache_lookup(&bs->m_freq_hash, bs->m_freq,
+                                     header1.m_freq, LZFSE_ENCODE_M_SYMBOLS))
+          fse_init_value_decoder_table(
+              LZFSE_ENCODE_M_STATES, LZFSE_ENCODE_M_SYMBOLS, header1.m_freq,
+              m_extra_bits, m_base_value, bs->m_decoder);
+        if (!lzfse_freq_cache_lookup(&bs->d_freq_hash, bs->d_freq,
+                                     header1.d_freq, LZFSE_ENCODE_D_SYMBOLS))
+          fse_init_value_decoder_table(
+              LZFSE_ENCODE_D_STATES, LZFSE_ENCODE_D_SYMBOLS, header1.d_freq,
+              d_extra_bits, d_base_value, bs->d_decoder);
 
         // Decode literals
         {
@@ -519,6 +804,9 @@ int lzfse_decode(lzfse_decoder_state *s) {
         }
 
         s->block_magic = magic;
+        s->n_blocks[magic == LZFSE_COMPRESSEDV2_BLOCK_MAGIC
+                        ? LZFSE_STAT_BLOCK_V2
+                        : LZFSE_STAT_BLOCK_V1]++;
         break;
       }
 
@@ -529,6 +817,16 @@ int lzfse_decode(lzfse_decoder_state *s) {
     case LZFSE_UNCOMPRESSED_BLOCK_MAGIC: {
       uncompressed_block_decoder_state *bs = &(s->uncompressed_block_state);
 
+      if (s->validate) {
+        // Nothing to check, skip the block
+        if (bs->n_raw_bytes > (size_t)(s->src_end - s->src))
+          return LZFSE_STATUS_SRC_EMPTY; // need all the block
+        s->src += bs->n_raw_bytes;
+        s->validated_bytes += bs->n_raw_bytes;
+        s->block_magic = 0;
+        break;
+      }
+
       //  Compute the size (in bytes) of the data that we will actually copy.
       //  This size is minimum(bs->n_raw_bytes, space in src, space in dst).
 
@@ -553,7 +851,10 @@ int lzfse_decode(lzfse_decoder_state *s) {
       // Now that we know that the copy size is bounded to the source and
       // dest buffers, go ahead and copy the data.
       // We always have copy_size > 0 here
-      memcpy(s->dst, s->src, copy_size);
+      if (s->in_place)
+        memmove(s->dst, s->src, copy_size);
+      else
+        memcpy(s->dst, s->src, copy_size);
       s->src += copy_size;
       s->dst += copy_size;
       bs->n_raw_bytes -= copy_size;
@@ -570,7 +871,7 @@ int lzfse_decode(lzfse_decoder_state *s) {
           bs->n_lmd_payload_bytes > (size_t)(s->src_end - s->src))
         return LZFSE_STATUS_SRC_EMPTY;
 
-      int status = lzfse_decode_lmd(s);
+      int status = s->validate ? lzfse_validate_lmd(s) : lzfse_decode_lmd(s);
       if (status != LZFSE_STATUS_OK)
         return status;
 
@@ -585,6 +886,19 @@ int lzfse_decode(lzfse_decoder_state *s) {
       if (bs->n_payload_bytes > 0 && s->src_end <= s->src)
         return LZFSE_STATUS_SRC_EMPTY; // need more SRC data
 
+      if (s->validate) {
+        // Check the entire block at once
+        if (bs->n_payload_bytes > (size_t)(s->src_end - s->src))
+          return LZFSE_STATUS_SRC_EMPTY; // need all the block
+        if (lzvn_validate(s->src, bs->n_payload_bytes, bs->n_raw_bytes,
+                          s->validated_bytes) != 0)
+          return LZFSE_STATUS_ERROR;
+        s->src += bs->n_payload_bytes;
+        s->validated_bytes += bs->n_raw_bytes;
+        s->block_magic = 0;
+        break;
+      }
+
       // Init LZVN decoder state
       lzvn_decoder_state dstate;
       memset(&dstate, 0x00, sizeof(dstate));
@@ -640,6 +954,8 @@ int lzfse_decode(lzfse_decoder_state *s) {
   return LZFSE_STATUS_OK;
 }
 
+EXPORT_SYMBOL(lzfse_decode_block_info);
+EXPORT_SYMBOL(lzfse_decode_block_freq);
 EXPORT_SYMBOL(lzfse_decode);
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("Lzfse Decompressor");
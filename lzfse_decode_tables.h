@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:  
+
+1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+    in the documentation and/or other materials provided with the distribution.
+
+3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LZFSE_DECODE_TABLES_H
+#define LZFSE_DECODE_TABLES_H
+
+//  Multi-symbol decoding table for the frequency codes of a compressed v2
+//  block header, indexed by the next 10 bits of the header bit stream.
+//  Each entry decodes the longest run of short (2, 3 or 5 bits) codes that
+//  fits entirely in those 10 bits:
+//    bits  0..14  up to 5 decoded values, 3 bits each, first value in LSB
+//    bits 16..18  number of decoded values, 0 if the first code is a long
+//                 (8 or 14 bits) code and must be decoded separately
+//    bits 24..27  total number of bits consumed by the decoded values
+//  Generated from the single-code tables of lzfse_decode_v1_freq_value.
+#define LZFSE_FREQ_MULTI_TABLE_BITS 10
+
+static const uint32_t lzfse_freq_multi_table[1 << LZFSE_FREQ_MULTI_TABLE_BITS] = {
+      0x0a050000, 0x09040002, 0x0a050001, 0x09030004, 0x09040010, 0x09040003,
+      0x09040011, 0x00000000, 0x0a050008, 0x0a040012, 0x0a050009, 0x09030005,
+      0x09030020, 0x0a040013, 0x09030021, 0x00000000, 0x09040080, 0x0904000a,
+      0x09040081, 0x09030006, 0x09040018, 0x0904000b, 0x09040019, 0x00000000,
+      0x09040088, 0x0a030022, 0x09040089, 0x09030007, 0x02010000, 0x0a030023,
+      0x02010001, 0x00000000, 0x0a050040, 0x0a040082, 0x0a050041, 0x0a030014,
+      0x0a040090, 0x0a040083, 0x0a040091, 0x00000000, 0x0a050048, 0x0a04001a,
+      0x0a050049, 0x0a030015, 0x09030028, 0x0a04001b, 0x09030029, 0x00000000,
+      0x09030100, 0x0a04008a, 0x09030101, 0x0a030016, 0x0a040098, 0x0a04008b,
+      0x0a040099, 0x00000000, 0x09030108, 0x03010002, 0x09030109, 0x0a030017,
+      0x02010000, 0x03010003, 0x02010001, 0x00000000, 0x09040400, 0x09040042,
+      0x09040401, 0x0903000c, 0x09040050, 0x09040043, 0x09040051, 0x00000000,
+      0x09040408, 0x09030092, 0x09040409, 0x0903000d, 0x09030030, 0x09030093,
+      0x09030031, 0x00000000, 0x090400c0, 0x0904004a, 0x090400c1, 0x0903000e,
+      0x09040058, 0x0904004b, 0x09040059, 0x00000000, 0x090400c8, 0x0a03002a,
+      0x090400c9, 0x0903000f, 0x02010000, 0x0a03002b, 0x02010001, 0x00000000,
+      0x09040440, 0x0a030102, 0x09040441, 0x0a020024, 0x0a030110, 0x0a030103,
+      0x0a030111, 0x00000000, 0x09040448, 0x0903009a, 0x09040449, 0x0a020025,
+      0x09030038, 0x0903009b, 0x09030039, 0x00000000, 0x04020000, 0x0a03010a,
+      0x04020001, 0x0a020026, 0x0a030118, 0x0a03010b, 0x0a030119, 0x00000000,
+      0x04020008, 0x03010002, 0x04020009, 0x0a020027, 0x02010000, 0x03010003,
+      0x02010001, 0x00000000, 0x0a050200, 0x0a040402, 0x0a050201, 0x0a030084,
+      0x0a040410, 0x0a040403, 0x0a040411, 0x00000000, 0x0a050208, 0x0a040052,
+      0x0a050209, 0x0a030085, 0x0a0300a0, 0x0a040053, 0x0a0300a1, 0x00000000,
+      0x0a040480, 0x0a04040a, 0x0a040481, 0x0a030086, 0x0a040418, 0x0a04040b,
+      0x0a040419, 0x00000000, 0x0a040488, 0x0a030032, 0x0a040489, 0x0a030087,
+      0x02010000, 0x0a030033, 0x02010001, 0x00000000, 0x0a050240, 0x0a0400c2,
+      0x0a050241, 0x0a03001c, 0x0a0400d0, 0x0a0400c3, 0x0a0400d1, 0x00000000,
+      0x0a050248, 0x0a04005a, 0x0a050249, 0x0a03001d, 0x0a0300a8, 0x0a04005b,
+      0x0a0300a9, 0x00000000, 0x09030140, 0x0a0400ca, 0x09030141, 0x0a03001e,
+      0x0a0400d8, 0x0a0400cb, 0x0a0400d9, 0x00000000, 0x09030148, 0x03010002,
+      0x09030149, 0x0a03001f, 0x02010000, 0x03010003, 0x02010001, 0x00000000,
+      0x06030000, 0x0a040442, 0x06030001, 0x0a03008c, 0x0a040450, 0x0a040443,
+      0x0a040451, 0x00000000, 0x06030008, 0x06020012, 0x06030009, 0x0a03008d,
+      0x0a0300b0, 0x06020013, 0x0a0300b1, 0x00000000, 0x0a0404c0, 0x0a04044a,
+      0x0a0404c1, 0x0a03008e, 0x0a040458, 0x0a04044b, 0x0a040459, 0x00000000,
+      0x0a0404c8, 0x0a03003a, 0x0a0404c9, 0x0a03008f, 0x02010000, 0x0a03003b,
+      0x02010001, 0x00000000, 0x06030040, 0x05020002, 0x06030041, 0x05010004,
+      0x05020010, 0x05020003, 0x05020011, 0x00000000, 0x06030048, 0x0602001a,
+      0x06030049, 0x05010005, 0x0a0300b8, 0x0602001b, 0x0a0300b9, 0x00000000,
+      0x04020000, 0x0502000a, 0x04020001, 0x05010006, 0x05020018, 0x0502000b,
+      0x05020019, 0x00000000, 0x04020008, 0x03010002, 0x04020009, 0x05010007,
+      0x02010000, 0x03010003, 0x02010001, 0x00000000, 0x08040000, 0x09040202,
+      0x08040001, 0x09030044, 0x09040210, 0x09040203, 0x09040211, 0x00000000,
+      0x08040008, 0x08030012, 0x08040009, 0x09030045, 0x09030060, 0x08030013,
+      0x09030061, 0x00000000, 0x09040280, 0x0904020a, 0x09040281, 0x09030046,
+      0x09040218, 0x0904020b, 0x09040219, 0x00000000, 0x09040288, 0x08020022,
+      0x09040289, 0x09030047, 0x02010000, 0x08020023, 0x02010001, 0x00000000,
+      0x08040040, 0x08030082, 0x08040041, 0x08020014, 0x08030090, 0x08030083,
+      0x08030091, 0x00000000, 0x08040048, 0x0803001a, 0x08040049, 0x08020015,
+      0x09030068, 0x0803001b, 0x09030069, 0x00000000, 0x09030180, 0x0803008a,
+      0x09030181, 0x08020016, 0x08030098, 0x0803008b, 0x08030099, 0x00000000,
+      0x09030188, 0x03010002, 0x09030189, 0x08020017, 0x02010000, 0x03010003,
+      0x02010001, 0x00000000, 0x09040600, 0x09040242, 0x09040601, 0x0903004c,
+      0x09040250, 0x09040243, 0x09040251, 0x00000000, 0x09040608, 0x090300d2,
+      0x09040609, 0x0903004d, 0x09030070, 0x090300d3, 0x09030071, 0x00000000,
+      0x090402c0, 0x0904024a, 0x090402c1, 0x0903004e, 0x09040258, 0x0904024b,
+      0x09040259, 0x00000000, 0x090402c8, 0x0802002a, 0x090402c9, 0x0903004f,
+      0x02010000, 0x0802002b, 0x02010001, 0x00000000, 0x09040640, 0x0a030142,
+      0x09040641, 0x0a02002c, 0x0a030150, 0x0a030143, 0x0a030151, 0x00000000,
+      0x09040648, 0x090300da, 0x09040649, 0x0a02002d, 0x09030078, 0x090300db,
+      0x09030079, 0x00000000, 0x04020000, 0x0a03014a, 0x04020001, 0x0a02002e,
+      0x0a030158, 0x0a03014b, 0x0a030159, 0x00000000, 0x04020008, 0x03010002,
+      0x04020009, 0x0a02002f, 0x02010000, 0x03010003, 0x02010001, 0x00000000,
+      0x08040200, 0x07030002, 0x08040201, 0x07020004, 0x07030010, 0x07030003,
+      0x07030011, 0x00000000, 0x08040208, 0x08030052, 0x08040209, 0x07020005,
+      0x07020020, 0x08030053, 0x07020021, 0x00000000, 0x07030080, 0x0703000a,
+      0x07030081, 0x07020006, 0x07030018, 0x0703000b, 0x07030019, 0x00000000,
+      0x07030088, 0x08020032, 0x07030089, 0x07020007, 0x02010000, 0x08020033,
+      0x02010001, 0x00000000, 0x08040240, 0x080300c2, 0x08040241, 0x0802001c,
+      0x080300d0, 0x080300c3, 0x080300d1, 0x00000000, 0x08040248, 0x0803005a,
+      0x08040249, 0x0802001d, 0x07020028, 0x0803005b, 0x07020029, 0x00000000,
+      0x090301c0, 0x080300ca, 0x090301c1, 0x0802001e, 0x080300d8, 0x080300cb,
+      0x080300d9, 0x00000000, 0x090301c8, 0x03010002, 0x090301c9, 0x0802001f,
+      0x02010000, 0x03010003, 0x02010001, 0x00000000, 0x06030000, 0x07030042,
+      0x06030001, 0x0702000c, 0x07030050, 0x07030043, 0x07030051, 0x00000000,
+      0x06030008, 0x06020012, 0x06030009, 0x0702000d, 0x07020030, 0x06020013,
+      0x07020031, 0x00000000, 0x070300c0, 0x0703004a, 0x070300c1, 0x0702000e,
+      0x07030058, 0x0703004b, 0x07030059, 0x00000000, 0x070300c8, 0x0802003a,
+      0x070300c9, 0x0702000f, 0x02010000, 0x0802003b, 0x02010001, 0x00000000,
+      0x06030040, 0x05020002, 0x06030041, 0x05010004, 0x05020010, 0x05020003,
+      0x05020011, 0x00000000, 0x06030048, 0x0602001a, 0x06030049, 0x05010005,
+      0x07020038, 0x0602001b, 0x07020039, 0x00000000, 0x04020000, 0x0502000a,
+      0x04020001, 0x05010006, 0x05020018, 0x0502000b, 0x05020019, 0x00000000,
+      0x04020008, 0x03010002, 0x04020009, 0x05010007, 0x02010000, 0x03010003,
+      0x02010001, 0x00000000, 0x0a051000, 0x09040002, 0x0a051001, 0x09030004,
+      0x09040010, 0x09040003, 0x09040011, 0x00000000, 0x0a051008, 0x0a040212,
+      0x0a051009, 0x09030005, 0x09030020, 0x0a040213, 0x09030021, 0x00000000,
+      0x09040080, 0x0904000a, 0x09040081, 0x09030006, 0x09040018, 0x0904000b,
+      0x09040019, 0x00000000, 0x09040088, 0x0a030062, 0x09040089, 0x09030007,
+      0x02010000, 0x0a030063, 0x02010001, 0x00000000, 0x0a051040, 0x0a040282,
+      0x0a051041, 0x0a030054, 0x0a040290, 0x0a040283, 0x0a040291, 0x00000000,
+      0x0a051048, 0x0a04021a, 0x0a051049, 0x0a030055, 0x09030028, 0x0a04021b,
+      0x09030029, 0x00000000, 0x09030100, 0x0a04028a, 0x09030101, 0x0a030056,
+      0x0a040298, 0x0a04028b, 0x0a040299, 0x00000000, 0x09030108, 0x03010002,
+      0x09030109, 0x0a030057, 0x02010000, 0x03010003, 0x02010001, 0x00000000,
+      0x09040400, 0x09040042, 0x09040401, 0x0903000c, 0x09040050, 0x09040043,
+      0x09040051, 0x00000000, 0x09040408, 0x09030092, 0x09040409, 0x0903000d,
+      0x09030030, 0x09030093, 0x09030031, 0x00000000, 0x090400c0, 0x0904004a,
+      0x090400c1, 0x0903000e, 0x09040058, 0x0904004b, 0x09040059, 0x00000000,
+      0x090400c8, 0x0a03006a, 0x090400c9, 0x0903000f, 0x02010000, 0x0a03006b,
+      0x02010001, 0x00000000, 0x09040440, 0x0a030182, 0x09040441, 0x0a020034,
+      0x0a030190, 0x0a030183, 0x0a030191, 0x00000000, 0x09040448, 0x0903009a,
+      0x09040449, 0x0a020035, 0x09030038, 0x0903009b, 0x09030039, 0x00000000,
+      0x04020000, 0x0a03018a, 0x04020001, 0x0a020036, 0x0a030198, 0x0a03018b,
+      0x0a030199, 0x00000000, 0x04020008, 0x03010002, 0x04020009, 0x0a020037,
+      0x02010000, 0x03010003, 0x02010001, 0x00000000, 0x0a051200, 0x0a040602,
+      0x0a051201, 0x0a0300c4, 0x0a040610, 0x0a040603, 0x0a040611, 0x00000000,
+      0x0a051208, 0x0a040252, 0x0a051209, 0x0a0300c5, 0x0a0300e0, 0x0a040253,
+      0x0a0300e1, 0x00000000, 0x0a040680, 0x0a04060a, 0x0a040681, 0x0a0300c6,
+      0x0a040618, 0x0a04060b, 0x0a040619, 0x00000000, 0x0a040688, 0x0a030072,
+      0x0a040689, 0x0a0300c7, 0x02010000, 0x0a030073, 0x02010001, 0x00000000,
+      0x0a051240, 0x0a0402c2, 0x0a051241, 0x0a03005c, 0x0a0402d0, 0x0a0402c3,
+      0x0a0402d1, 0x00000000, 0x0a051248, 0x0a04025a, 0x0a051249, 0x0a03005d,
+      0x0a0300e8, 0x0a04025b, 0x0a0300e9, 0x00000000, 0x09030140, 0x0a0402ca,
+      0x09030141, 0x0a03005e, 0x0a0402d8, 0x0a0402cb, 0x0a0402d9, 0x00000000,
+      0x09030148, 0x03010002, 0x09030149, 0x0a03005f, 0x02010000, 0x03010003,
+      0x02010001, 0x00000000, 0x06030000, 0x0a040642, 0x06030001, 0x0a0300cc,
+      0x0a040650, 0x0a040643, 0x0a040651, 0x00000000, 0x06030008, 0x06020012,
+      0x06030009, 0x0a0300cd, 0x0a0300f0, 0x06020013, 0x0a0300f1, 0x00000000,
+      0x0a0406c0, 0x0a04064a, 0x0a0406c1, 0x0a0300ce, 0x0a040658, 0x0a04064b,
+      0x0a040659, 0x00000000, 0x0a0406c8, 0x0a03007a, 0x0a0406c9, 0x0a0300cf,
+      0x02010000, 0x0a03007b, 0x02010001, 0x00000000, 0x06030040, 0x05020002,
+      0x06030041, 0x05010004, 0x05020010, 0x05020003, 0x05020011, 0x00000000,
+      0x06030048, 0x0602001a, 0x06030049, 0x05010005, 0x0a0300f8, 0x0602001b,
+      0x0a0300f9, 0x00000000, 0x04020000, 0x0502000a, 0x04020001, 0x05010006,
+      0x05020018, 0x0502000b, 0x05020019, 0x00000000, 0x04020008, 0x03010002,
+      0x04020009, 0x05010007, 0x02010000, 0x03010003, 0x02010001, 0x00000000,
+      0x08040000, 0x09040202, 0x08040001, 0x09030044, 0x09040210, 0x09040203,
+      0x09040211, 0x00000000, 0x08040008, 0x08030012, 0x08040009, 0x09030045,
+      0x09030060, 0x08030013, 0x09030061, 0x00000000, 0x09040280, 0x0904020a,
+      0x09040281, 0x09030046, 0x09040218, 0x0904020b, 0x09040219, 0x00000000,
+      0x09040288, 0x08020022, 0x09040289, 0x09030047, 0x02010000, 0x08020023,
+      0x02010001, 0x00000000, 0x08040040, 0x08030082, 0x08040041, 0x08020014,
+      0x08030090, 0x08030083, 0x08030091, 0x00000000, 0x08040048, 0x0803001a,
+      0x08040049, 0x08020015, 0x09030068, 0x0803001b, 0x09030069, 0x00000000,
+      0x09030180, 0x0803008a, 0x09030181, 0x08020016, 0x08030098, 0x0803008b,
+      0x08030099, 0x00000000, 0x09030188, 0x03010002, 0x09030189, 0x08020017,
+      0x02010000, 0x03010003, 0x02010001, 0x00000000, 0x09040600, 0x09040242,
+      0x09040601, 0x0903004c, 0x09040250, 0x09040243, 0x09040251, 0x00000000,
+      0x09040608, 0x090300d2, 0x09040609, 0x0903004d, 0x09030070, 0x090300d3,
+      0x09030071, 0x00000000, 0x090402c0, 0x0904024a, 0x090402c1, 0x0903004e,
+      0x09040258, 0x0904024b, 0x09040259, 0x00000000, 0x090402c8, 0x0802002a,
+      0x090402c9, 0x0903004f, 0x02010000, 0x0802002b, 0x02010001, 0x00000000,
+      0x09040640, 0x0a0301c2, 0x09040641, 0x0a02003c, 0x0a0301d0, 0x0a0301c3,
+      0x0a0301d1, 0x00000000, 0x09040648, 0x090300da, 0x09040649, 0x0a02003d,
+      0x09030078, 0x090300db, 0x09030079, 0x00000000, 0x04020000, 0x0a0301ca,
+      0x04020001, 0x0a02003e, 0x0a0301d8, 0x0a0301cb, 0x0a0301d9, 0x00000000,
+      0x04020008, 0x03010002, 0x04020009, 0x0a02003f, 0x02010000, 0x03010003,
+      0x02010001, 0x00000000, 0x08040200, 0x07030002, 0x08040201, 0x07020004,
+      0x07030010, 0x07030003, 0x07030011, 0x00000000, 0x08040208, 0x08030052,
+      0x08040209, 0x07020005, 0x07020020, 0x08030053, 0x07020021, 0x00000000,
+      0x07030080, 0x0703000a, 0x07030081, 0x07020006, 0x07030018, 0x0703000b,
+      0x07030019, 0x00000000, 0x07030088, 0x08020032, 0x07030089, 0x07020007,
+      0x02010000, 0x08020033, 0x02010001, 0x00000000, 0x08040240, 0x080300c2,
+      0x08040241, 0x0802001c, 0x080300d0, 0x080300c3, 0x080300d1, 0x00000000,
+      0x08040248, 0x0803005a, 0x08040249, 0x0802001d, 0x07020028, 0x0803005b,
+      0x07020029, 0x00000000, 0x090301c0, 0x080300ca, 0x090301c1, 0x0802001e,
+      0x080300d8, 0x080300cb, 0x080300d9, 0x00000000, 0x090301c8, 0x03010002,
+      0x090301c9, 0x0802001f, 0x02010000, 0x03010003, 0x02010001, 0x00000000,
+      0x06030000, 0x07030042, 0x06030001, 0x0702000c, 0x07030050, 0x07030043,
+      0x07030051, 0x00000000, 0x06030008, 0x06020012, 0x06030009, 0x0702000d,
+      0x07020030, 0x06020013, 0x07020031, 0x00000000, 0x070300c0, 0x0703004a,
+      0x070300c1, 0x0702000e, 0x07030058, 0x0703004b, 0x07030059, 0x00000000,
+      0x070300c8, 0x0802003a, 0x070300c9, 0x0702000f, 0x02010000, 0x0802003b,
+      0x02010001, 0x00000000, 0x06030040, 0x05020002, 0x06030041, 0x05010004,
+      0x05020010, 0x05020003, 0x05020011, 0x00000000, 0x06030048, 0x0602001a,
+      0x06030049, 0x05010005, 0x07020038, 0x0602001b, 0x07020039, 0x00000000,
+      0x04020000, 0x0502000a, 0x04020001, 0x05010006, 0x05020018, 0x0502000b,
+      0x05020019, 0x00000000, 0x04020008, 0x03010002, 0x04020009, 0x05010007,
+      0x02010000, 0x03010003, 0x02010001, 0x00000000};
+
+#endif // LZFSE_DECODE_TABLES_H
@@ -25,7 +25,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #include "lzvn.h"
 #include "lzfse_internal.h"
 
-#if __linux__
+#ifdef __KERNEL__
 #include <linux/module.h>
 #endif
 
@@ -35,9 +35,10 @@ size_t lzfse_encode_scratch_size() {
   return (s1 > s2) ? s1 : s2; // max(lzfse,lzvn)
 }
 
-size_t lzfse_encode_buffer(uint8_t *dst_buffer,
-			   size_t dst_size, const uint8_t *src_buffer,
-			   size_t src_size, void *scratch_buffer) {
+static size_t lzfse_encode_buffer_impl(uint8_t *dst_buffer, size_t dst_size,
+                                       const uint8_t *src_buffer,
+                                       size_t src_size, void *scratch_buffer,
+                                       int lzvn_level) {
   const size_t original_size = src_size;
 
   // If input is really really small, go directly to uncompressed buffer
@@ -47,14 +48,17 @@ size_t lzfse_encode_buffer(uint8_t *dst_buffer,
 
   // If input is too small, try encoding with LZVN
   if (src_size < LZFSE_ENCODE_LZVN_THRESHOLD) {
+    LZFSE_STAT_INC(encode_lzvn);
+    trace_lzfse_encode_fallback(LZFSE_TRACE_PATH_LZVN, src_size, dst_size);
     // need header + end-of-stream marker
     size_t extra_size = 4 + sizeof(lzvn_compressed_block_header);
     if (dst_size <= extra_size)
       goto try_uncompressed; // DST is really too small, give up
 
-    size_t sz = lzvn_encode_buffer(
+    size_t sz = lzvn_encode_buffer_level(
         dst_buffer + sizeof(lzvn_compressed_block_header),
-        dst_size - extra_size, src_buffer, src_size, scratch_buffer);
+        dst_size - extra_size, src_buffer, src_size, scratch_buffer,
+        lzvn_level);
     if (sz == 0 || sz >= src_size)
       goto try_uncompressed; // failed, or no compression, fall back to
                              // uncompressed block
@@ -68,6 +72,12 @@ size_t lzfse_encode_buffer(uint8_t *dst_buffer,
     memcpy(dst_buffer, &header, sizeof(header));
     store4(dst_buffer + sizeof(lzvn_compressed_block_header) + sz,
            LZFSE_ENDOFSTREAM_BLOCK_MAGIC);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_LZVN]);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_ENDOFSTREAM]);
+    trace_lzfse_encode_block(LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC,
+                             (uint32_t)src_size,
+                             (uint32_t)(sizeof(header) + sz));
+    trace_lzfse_encode_block(LZFSE_ENDOFSTREAM_BLOCK_MAGIC, 0, 4);
 
     return sz + extra_size;
   }
@@ -83,6 +93,10 @@ size_t lzfse_encode_buffer(uint8_t *dst_buffer,
     state->dst_end = &dst_buffer[dst_size];
     state->src = src_buffer;
     state->src_encode_i = 0;
+    //  A DST smaller than SRC is an output budget (the caller only wants the
+    //  result if it compresses well enough): give up as soon as it provably
+    //  cannot be met, instead of encoding everything first.
+    state->early_abort = dst_size < src_size;
 
     if (src_size >= 0xffffffffU) {
       //  lzfse only uses 32 bits for offsets internally, so if the input
@@ -92,6 +106,8 @@ size_t lzfse_encode_buffer(uint8_t *dst_buffer,
       //  it's necessary for correctness.
       //  The first chunk, we just process normally.
       const lzfse_offset encoder_block_size = 262144;
+      LZFSE_STAT_INC(encode_chunked);
+      trace_lzfse_encode_fallback(LZFSE_TRACE_PATH_CHUNKED, src_size, dst_size);
       state->src_end = encoder_block_size;
       if (lzfse_encode_base(state) != LZFSE_STATUS_OK)
         goto try_uncompressed;
@@ -122,6 +138,8 @@ size_t lzfse_encode_buffer(uint8_t *dst_buffer,
     if (lzfse_encode_finish(state) != LZFSE_STATUS_OK)
       goto try_uncompressed;
     //  No error occured, return compressed size.
+    LZFSE_STAT_ADD(encode_blocks[LZFSE_STAT_BLOCK_V2], state->n_blocks);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_ENDOFSTREAM]);
     return state->dst - dst_buffer;
   }
 
@@ -138,14 +156,188 @@ try_uncompressed:
     dst_end += original_size;
     store4(dst_end, LZFSE_ENDOFSTREAM_BLOCK_MAGIC);
     dst_end += 4;
+    LZFSE_STAT_INC(encode_uncompressed);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_UNCOMPRESSED]);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_ENDOFSTREAM]);
+    trace_lzfse_encode_fallback(LZFSE_TRACE_PATH_UNCOMPRESSED, original_size,
+                                dst_size);
+    trace_lzfse_encode_block(LZFSE_UNCOMPRESSED_BLOCK_MAGIC,
+                             (uint32_t)original_size,
+                             (uint32_t)(sizeof(header) + original_size));
+    trace_lzfse_encode_block(LZFSE_ENDOFSTREAM_BLOCK_MAGIC, 0, 4);
     return dst_end - dst_buffer;
   }
 
   //  Otherwise, there's nothing we can do, so return zero.
+  trace_lzfse_encode_fallback(LZFSE_TRACE_PATH_FAILED, original_size,
+                              dst_size);
+  return 0;
+}
+
+//  Add an encode call of SRC_SIZE bytes, which returned SZ and started at
+//  time T, to the statistics.
+static void lzfse_encode_account(size_t src_size, size_t sz, uint64_t t) {
+  LZFSE_STAT_INC(encode_calls);
+  LZFSE_STAT_ADD(encode_bytes_in, src_size);
+  LZFSE_STAT_ADD(encode_bytes_out, sz);
+  LZFSE_STAT_ADD(encode_ns, LZFSE_STAT_TIME() - t);
+  if (sz == 0)
+    LZFSE_STAT_INC(encode_failed);
+}
+
+size_t lzfse_encode_buffer_level(uint8_t *dst_buffer,
+				 size_t dst_size, const uint8_t *src_buffer,
+				 size_t src_size, void *scratch_buffer,
+				 int lzvn_level) {
+  uint64_t t = LZFSE_STAT_TIME();
+  size_t sz;
+
+  trace_lzfse_encode_enter(src_size, dst_size);
+  sz = lzfse_encode_buffer_impl(dst_buffer, dst_size, src_buffer, src_size,
+                                scratch_buffer, lzvn_level);
+  trace_lzfse_encode_exit(src_size, sz);
+  lzfse_encode_account(src_size, sz, t);
+  return sz;
+}
+
+size_t lzfse_encode_buffer(uint8_t *dst_buffer,
+			   size_t dst_size, const uint8_t *src_buffer,
+			   size_t src_size, void *scratch_buffer) {
+  return lzfse_encode_buffer_level(dst_buffer, dst_size, src_buffer, src_size,
+                                   scratch_buffer, LZVN_ENCODE_LEVEL_DEFAULT);
+}
+
+size_t lzfse_encode_segments_scratch_size() {
+  return lzfse_encode_scratch_size() + LZFSE_SEGMENT_WINDOW_SIZE;
+}
+
+//  Copy the next N bytes of segments SEG, from segment *I at offset *OFF, to
+//  DST, and advance (*I, *OFF). The segments must hold at least N more bytes.
+static void lzfse_segments_gather(uint8_t *dst, const lzfse_segment *seg,
+                                  size_t *i, size_t *off, size_t n) {
+  while (n > 0) {
+    size_t k = seg[*i].size - *off;
+    if (k > n)
+      k = n;
+    memcpy(dst, (const uint8_t *)seg[*i].base + *off, k);
+    dst += k;
+    n -= k;
+    *off += k;
+    if (*off == seg[*i].size) {
+      (*i)++;
+      *off = 0;
+    }
+  }
+}
+
+static size_t lzfse_encode_segments_impl(uint8_t *dst_buffer, size_t dst_size,
+                                         const lzfse_segment *src,
+                                         size_t n_src, size_t src_size,
+                                         void *scratch_buffer) {
+  uint8_t *window = (uint8_t *)scratch_buffer + lzfse_encode_scratch_size();
+  size_t i = 0, off = 0;
+
+  //  A single segment is already contiguous
+  if (n_src == 1)
+    return lzfse_encode_buffer_impl(dst_buffer, dst_size, src[0].base,
+                                    src_size, scratch_buffer,
+                                    LZVN_ENCODE_LEVEL_DEFAULT);
+
+  //  If the whole input fits in the window, gather it there and encode it as
+  //  a single buffer
+  if (src_size <= LZFSE_SEGMENT_WINDOW_SIZE) {
+    lzfse_segments_gather(window, src, &i, &off, src_size);
+    return lzfse_encode_buffer_impl(dst_buffer, dst_size, window, src_size,
+                                    scratch_buffer, LZVN_ENCODE_LEVEL_DEFAULT);
+  }
+
+  //  Otherwise, feed the encoder one chunk at a time. When the window is full,
+  //  translate the encoder state and move the last LZFSE_SEGMENT_HISTORY_SIZE
+  //  bytes to the start of the window, so that all positions the encoder can
+  //  still reference stay in the window.
+  {
+    lzfse_encoder_state *state = scratch_buffer;
+    size_t filled = 0;
+    size_t remaining = src_size;
+
+    memset(state, 0x00, sizeof *state);
+    if (lzfse_encode_init(state) != LZFSE_STATUS_OK)
+      goto try_uncompressed;
+    state->dst = dst_buffer;
+    state->dst_begin = dst_buffer;
+    state->dst_end = &dst_buffer[dst_size];
+    state->src = window;
+    state->src_encode_i = 0;
+    state->early_abort = dst_size < src_size;
+
+    while (remaining > 0) {
+      size_t n = remaining < LZFSE_SEGMENT_CHUNK_SIZE ? remaining
+                                                       : LZFSE_SEGMENT_CHUNK_SIZE;
+      if (filled + n > LZFSE_SEGMENT_WINDOW_SIZE) {
+        const size_t delta = filled - LZFSE_SEGMENT_HISTORY_SIZE;
+        lzfse_encode_translate(state, (lzfse_offset)delta);
+        memmove(window, window + delta, LZFSE_SEGMENT_HISTORY_SIZE);
+        state->src = window;
+        filled = LZFSE_SEGMENT_HISTORY_SIZE;
+      }
+      lzfse_segments_gather(window + filled, src, &i, &off, n);
+      filled += n;
+      remaining -= n;
+      state->src_end = (lzfse_offset)filled;
+      if (lzfse_encode_base(state) != LZFSE_STATUS_OK)
+        goto try_uncompressed;
+    }
+    if (lzfse_encode_finish(state) != LZFSE_STATUS_OK)
+      goto try_uncompressed;
+    LZFSE_STAT_ADD(encode_blocks[LZFSE_STAT_BLOCK_V2], state->n_blocks);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_ENDOFSTREAM]);
+    return state->dst - dst_buffer;
+  }
+
+try_uncompressed:
+  //  Same fallback as lzfse_encode_buffer, gathering the segments directly to
+  //  the output.
+  if (src_size + 12 <= dst_size && src_size < S32_MAX) {
+    uncompressed_block_header header = {.magic = LZFSE_UNCOMPRESSED_BLOCK_MAGIC,
+                                        .n_raw_bytes = (uint32_t)src_size};
+    uint8_t *dst_end = dst_buffer;
+    memcpy(dst_end, &header, sizeof header);
+    dst_end += sizeof header;
+    i = off = 0;
+    lzfse_segments_gather(dst_end, src, &i, &off, src_size);
+    dst_end += src_size;
+    store4(dst_end, LZFSE_ENDOFSTREAM_BLOCK_MAGIC);
+    dst_end += 4;
+    LZFSE_STAT_INC(encode_uncompressed);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_UNCOMPRESSED]);
+    LZFSE_STAT_INC(encode_blocks[LZFSE_STAT_BLOCK_ENDOFSTREAM]);
+    return dst_end - dst_buffer;
+  }
   return 0;
 }
 
+size_t lzfse_encode_segments(uint8_t *dst_buffer, size_t dst_size,
+                             const lzfse_segment *src, size_t n_src,
+                             void *scratch_buffer) {
+  uint64_t t = LZFSE_STAT_TIME();
+  size_t src_size = 0;
+  size_t k, sz;
+
+  for (k = 0; k < n_src; k++)
+    src_size += src[k].size;
+
+  trace_lzfse_encode_enter(src_size, dst_size);
+  sz = lzfse_encode_segments_impl(dst_buffer, dst_size, src, n_src, src_size,
+                                  scratch_buffer);
+  trace_lzfse_encode_exit(src_size, sz);
+  lzfse_encode_account(src_size, sz, t);
+  return sz;
+}
+
 EXPORT_SYMBOL(lzfse_encode_scratch_size);
 EXPORT_SYMBOL(lzfse_encode_buffer);
+EXPORT_SYMBOL(lzfse_encode_buffer_level);
+EXPORT_SYMBOL(lzfse_encode_segments_scratch_size);
+EXPORT_SYMBOL(lzfse_encode_segments);
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("Lzfse Compressor");
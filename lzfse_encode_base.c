@@ -24,7 +24,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #include "lzfse_internal.h"
 #include "lzfse_encode_tables.h"
 
-#if __linux__
+#ifdef __KERNEL__
 #include <linux/module.h>
 #endif
 
@@ -177,6 +177,8 @@ static int lzfse_encode_matches(lzfse_encoder_state *s) {
   if (s->n_literals == 0 && s->n_matches == 0)
     return LZFSE_STATUS_OK; // nothing to store, OK
 
+  int stage = LZFSE_STAGE_ENTER(s, LZFSE_STAGE_HISTOGRAM);
+
   uint32_t l_occ[LZFSE_ENCODE_L_SYMBOLS];
   uint32_t m_occ[LZFSE_ENCODE_M_SYMBOLS];
   uint32_t d_occ[LZFSE_ENCODE_D_SYMBOLS];
@@ -259,9 +261,11 @@ static int lzfse_encode_matches(lzfse_encoder_state *s) {
                      literal_occ, header1.literal_freq);
 
   // Compress freq tables to V2 header, and get actual size of V2 header
+  LZFSE_STAGE_SWITCH(s, LZFSE_STAGE_HEADER);
   s->dst += lzfse_encode_v1_freq_table(header2, &header1);
 
   // Initialize encoder tables from freq tables
+  LZFSE_STAGE_SWITCH(s, LZFSE_STAGE_TABLES);
   fse_init_encoder_table(LZFSE_ENCODE_L_STATES, LZFSE_ENCODE_L_SYMBOLS,
                          header1.l_freq, l_encoder);
   fse_init_encoder_table(LZFSE_ENCODE_M_STATES, LZFSE_ENCODE_M_SYMBOLS,
@@ -273,6 +277,7 @@ static int lzfse_encode_matches(lzfse_encoder_state *s) {
                          literal_encoder);
 
   // Encode literals
+  LZFSE_STAGE_SWITCH(s, LZFSE_STAGE_LITERALS);
   {
     fse_out_stream out;
     fse_out_init(&out);
@@ -314,6 +319,7 @@ static int lzfse_encode_matches(lzfse_encoder_state *s) {
   } // literals
 
   // Encode L,M,D
+  LZFSE_STAGE_SWITCH(s, LZFSE_STAGE_LMD);
   {
     fse_out_stream out;
     fse_out_init(&out);
@@ -389,6 +395,8 @@ static int lzfse_encode_matches(lzfse_encoder_state *s) {
   // revert state
   s->n_literals = 0;
   s->n_matches = 0;
+  memset(s->literal_hist, 0, sizeof(s->literal_hist));
+  s->literal_hist_n = 0;
 
   // Final payload size
   header1.n_payload_bytes =
@@ -396,9 +404,14 @@ static int lzfse_encode_matches(lzfse_encoder_state *s) {
 
   // Encode state info in V2 header (we previously encoded the tables, now we
   // set the other fields)
+  LZFSE_STAGE_SWITCH(s, LZFSE_STAGE_HEADER);
   lzfse_encode_v1_state(header2, &header1);
+  s->n_blocks++;
+  trace_lzfse_encode_block(LZFSE_COMPRESSEDV2_BLOCK_MAGIC, header1.n_raw_bytes,
+                           (uint32_t)(s->dst - dst0));
 
 END:
+  LZFSE_STAGE_LEAVE(s, stage);
   if (!ok) {
     // Revert state, DST was full
 
@@ -579,10 +592,34 @@ static int lzfse_backend_end_of_stream(lzfse_encoder_state *s) {
     return LZFSE_STATUS_DST_FULL; // DST full
   store4(s->dst, LZFSE_ENDOFSTREAM_BLOCK_MAGIC);
   s->dst += 4;
+  trace_lzfse_encode_block(LZFSE_ENDOFSTREAM_BLOCK_MAGIC, 0, 4);
 
   return LZFSE_STATUS_OK; // OK
 }
 
+/*! @abstract Return 1 if the output provably cannot fit in DST anymore.
+ * Bytes already written, plus the end-of-stream marker, plus a lower bound on
+ * the literal payload of the current block: the order-0 entropy of the
+ * literals, sum(c * log2(n / c)), rounded down symbol by symbol. FSE cannot
+ * code the literals below their entropy by more than its final state bits,
+ * which are covered by not counting the block header. */
+static int lzfse_encode_over_budget(lzfse_encoder_state *s) {
+  uint64_t bits = 0;
+  uint32_t n = s->n_literals;
+  uint32_t i;
+
+  for (i = s->literal_hist_n; i < n; i++)
+    s->literal_hist[s->literals[i]]++;
+  s->literal_hist_n = n;
+
+  for (i = 0; i < LZFSE_ENCODE_LITERAL_SYMBOLS; i++) {
+    uint32_t c = s->literal_hist[i];
+    if (c != 0 && c < n)
+      bits += (uint64_t)c * (31 - __builtin_clz(n / c));
+  }
+  return s->dst + bits / 8 + 4 > s->dst_end;
+}
+
 // ===============================================================
 // Encoder state management
 
@@ -592,6 +629,8 @@ static int lzfse_backend_end_of_stream(lzfse_encoder_state *s) {
  * - pending match to NO_MATCH.
  * - src_literal to 0.
  * - d_prev to 0.
+ * - n_blocks to 0.
+ * - instrument_stage to LZFSE_STAGE_OTHER (not timing).
  @endcode
  * @return LZFSE_STATUS_OK */
 int lzfse_encode_init(lzfse_encoder_state *s) {
@@ -608,6 +647,8 @@ int lzfse_encode_init(lzfse_encoder_state *s) {
     s->history_table[i] = line;
   s->pending = NO_MATCH;
   s->src_literal = 0;
+  s->n_blocks = 0;
+  s->instrument_stage = LZFSE_STAGE_OTHER;
 
   return LZFSE_STATUS_OK; // OK
 }
@@ -658,6 +699,7 @@ int lzfse_encode_base(lzfse_encoder_state *s) {
   lzfse_history_set newH;
   const lzfse_match NO_MATCH = {0};
   int ok = 1;
+  int stage = LZFSE_STAGE_ENTER(s, LZFSE_STAGE_MATCH_SEARCH);
 
   memset(&newH, 0x00, sizeof(newH));
 
@@ -811,12 +853,21 @@ int lzfse_encode_base(lzfse_encoder_state *s) {
     s->pending = NO_MATCH;
 
   END_POS:
+    // Give up if the literals pushed so far already exceed DST
+    if (s->early_abort &&
+        s->n_literals - s->literal_hist_n >= LZFSE_ENCODE_EARLY_ABORT_INTERVAL &&
+        lzfse_encode_over_budget(s)) {
+      ok = 0;
+      goto END;
+    }
+
     // We are done with this src_encode_i.
     // Update state now (s->pending has already been updated).
     *hashLine = newH;
   }
 
 END:
+  LZFSE_STAGE_LEAVE(s, stage);
   return ok ? LZFSE_STATUS_OK : LZFSE_STATUS_DST_FULL;
 }
 
@@ -79,22 +79,23 @@ int fse_init_decoder_table(int nstates, int nsymbols,
         __builtin_clz(f) - n_clz; // shift needed to ensure N <= (F<<K) < 2*N
     j0 = ((2 * nstates) >> k) - f;
 
-    // Initialize all states S reached by this symbol: OFFSET <= S < OFFSET + F
-    for (j = 0; j < f; j++) {
-      fse_decoder_entry e;
-
-      e.symbol = (uint8_t)i;
-      if (j < j0) {
-        e.k = (int8_t)k;
-        e.delta = (int16_t)(((f + j) << k) - nstates);
-      } else {
-        e.k = (int8_t)(k - 1);
-        e.delta = (int16_t)((j - j0) << (k - 1));
-      }
-
-      memcpy(t, &e, sizeof(e));
-      t++;
+    // Initialize all states S reached by this symbol: OFFSET <= S < OFFSET + F.
+    // Entries are written packed (K | SYMBOL << 8 | DELTA << 16, the layout
+    // fse_decode reads back). Within each of the two ranges below, DELTA is
+    // an arithmetic progression in J, so both loops are branch-free and the
+    // compiler can vectorize them.
+    if (j0 > f)
+      j0 = f;
+    uint32_t e0 = (uint32_t)k | ((uint32_t)i << 8);
+    uint32_t d0 = (uint32_t)((f << k) - nstates);
+    for (j = 0; j < j0; j++)
+      t[j] = (int32_t)(e0 + ((d0 + ((uint32_t)j << k)) << 16));
+    if (j0 < f) {
+      uint32_t e1 = (uint32_t)(k - 1) | ((uint32_t)i << 8);
+      for (j = j0; j < f; j++)
+        t[j] = (int32_t)(e1 + ((uint32_t)(j - j0) << (k - 1 + 16)));
     }
+    t += f;
   }
 
   return 0; // OK
@@ -132,21 +133,24 @@ void fse_init_value_decoder_table(int nstates, int nsymbols,
     ei.value_bits = symbol_vbits[i];
     ei.vbase = symbol_vbase[i];
 
-    // Initialize all states S reached by this symbol: OFFSET <= S < OFFSET + F
-    for (j = 0; j < f; j++) {
-      fse_value_decoder_entry e = ei;
-
-      if (j < j0) {
-        e.total_bits = (uint8_t)k + e.value_bits;
-        e.delta = (int16_t)(((f + j) << k) - nstates);
-      } else {
-        e.total_bits = (uint8_t)(k - 1) + e.value_bits;
-        e.delta = (int16_t)((j - j0) << (k - 1));
+    // Initialize all states S reached by this symbol: OFFSET <= S < OFFSET + F.
+    // As in fse_init_decoder_table, the range is split at J0 so that each
+    // loop has no data-dependent branch.
+    if (j0 > f)
+      j0 = f;
+    ei.total_bits = (uint8_t)k + ei.value_bits;
+    for (j = 0; j < j0; j++) {
+      t[j] = ei;
+      t[j].delta = (int16_t)(((f + j) << k) - nstates);
+    }
+    if (j0 < f) {
+      ei.total_bits = (uint8_t)(k - 1) + ei.value_bits;
+      for (j = j0; j < f; j++) {
+        t[j] = ei;
+        t[j].delta = (int16_t)((j - j0) << (k - 1));
       }
-
-      memcpy(t, &e, 8);
-      t++;
     }
+    t += f;
   }
 }
 
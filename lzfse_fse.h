@@ -26,11 +26,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #pragma once
 
 
-#include <linux/stddef.h>
-#include <linux/types.h>
-
-#include <linux/string.h>
-
+#include "lzfse_compat.h"
 #include "lzfse.h"
 
 #if defined(_MSC_VER) && !defined(__clang__)
@@ -358,6 +354,36 @@ FSE_INLINE int fse_in_checked_flush32(fse_in_stream32 *s, const uint8_t **pbuf,
   return 0; // OK
 }
 
+/*! @abstract Same as fse_in_checked_flush64, without checking that \c *pbuf
+ * remains >= \c buf_start. Only valid on streams known to be well formed. */
+FSE_INLINE void fse_in_unchecked_flush64(fse_in_stream64 *s,
+                                         const uint8_t **pbuf) {
+  fse_bit_count nbits = (63 - s->accum_nbits) & -8;
+  const uint8_t *buf = (*pbuf) - (nbits >> 3);
+  *pbuf = buf;
+  uint64_t incoming;
+  memcpy(&incoming, buf, 8);
+  s->accum = (s->accum << nbits) | fse_mask_lsb64(incoming, nbits);
+  s->accum_nbits += nbits;
+  DEBUG_CHECK_INPUT_STREAM_PARAMETERS
+}
+
+/*! @abstract Same as fse_in_checked_flush32, without checking that \c *pbuf
+ * remains >= \c buf_start. Only valid on streams known to be well formed. */
+FSE_INLINE void fse_in_unchecked_flush32(fse_in_stream32 *s,
+                                         const uint8_t **pbuf) {
+  fse_bit_count nbits = (31 - s->accum_nbits) & -8;
+  if (nbits > 0) {
+    const uint8_t *buf = (*pbuf) - (nbits >> 3);
+    *pbuf = buf;
+    uint32_t incoming;
+    memcpy(&incoming, buf, 4);
+    s->accum = (s->accum << nbits) | fse_mask_lsb32(incoming, nbits);
+    s->accum_nbits += nbits;
+  }
+  DEBUG_CHECK_INPUT_STREAM_PARAMETERS
+}
+
 /*! @abstract Pull n bits out of the fse stream object. */
 FSE_INLINE uint64_t fse_in_pull64(fse_in_stream64 *s, fse_bit_count n) {
   (n >= 0 && n <= s->accum_nbits);
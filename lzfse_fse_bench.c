@@ -0,0 +1,529 @@
+/*
+  Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+  2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+  in the documentation and/or other materials provided with the distribution.
+
+  3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Microbenchmarks for the FSE entropy coder primitives of lzfse_fse.h, over
+// synthetic symbol distributions and the three table sizes used by LZFSE.
+// The I/O stream width is fixed at build time: the Makefile builds this file
+// twice, as lzfse_fse_bench64 and lzfse_fse_bench32.
+
+#include "lzfse.h"
+#include "lzfse_internal.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#define MAX_SYMBOLS 256
+#define MAX_STATES 1024
+
+// Streams start after 8 zero bytes, as the L,M,D payload does, since the
+// decoder always loads 8 bytes at a time
+#define STREAM_PADDING 8
+
+// Table builds per pass, to stay well above the timer resolution
+#define TABLE_REPS 256
+
+// Symbols per flush, so that the accumulator never overflows: a symbol is at
+// most 10 bits, a value at most 8 + 15 bits, and a flush leaves up to 7 bits
+// in the output accumulator and at least 56 (24) bits in the input one.
+#if FSE_IOSTREAM_64
+#define SYMBOLS_PER_FLUSH 4
+#define VALUES_PER_FLUSH 2
+#else
+#define SYMBOLS_PER_FLUSH 2
+#define VALUES_PER_FLUSH 1
+#endif
+
+// One FSE table configuration of the LZFSE format
+typedef struct {
+	const char *name;
+	int nstates, nsymbols;
+	const uint8_t *vbits;	// value decoder extra bits, NULL if unused
+	const int32_t *vbase;
+} fse_config;
+
+static const fse_config configs[] = {
+	{ "L", LZFSE_ENCODE_L_STATES, LZFSE_ENCODE_L_SYMBOLS, l_extra_bits,
+	  l_base_value },
+	{ "D", LZFSE_ENCODE_D_STATES, LZFSE_ENCODE_D_SYMBOLS, d_extra_bits,
+	  d_base_value },
+	{ "literal", LZFSE_ENCODE_LITERAL_STATES, LZFSE_ENCODE_LITERAL_SYMBOLS,
+	  NULL, NULL },
+};
+#define N_CONFIGS (sizeof(configs) / sizeof(configs[0]))
+
+enum { DIST_UNIFORM = 0, DIST_SKEWED, DIST_PEAKED, N_DISTS };
+static const char *dist_names[N_DISTS] = { "uniform", "skewed", "peaked" };
+
+static double min_time = 0.2; // seconds per measurement
+static volatile uint32_t sink; // keeps results alive
+
+static void usage(const char *argv0) {
+	fprintf(stderr,
+		"Usage: %s [-n symbols] [-t seconds] [-h]\n"
+		"  -n  symbols per coding pass (default: 65536)\n"
+		"  -t  minimum time per measurement in seconds (default: 0.2)\n",
+		argv0);
+}
+
+static void *xmalloc(size_t size) {
+	void *p = malloc(size ? size : 1);
+
+	if (p == NULL) {
+		fprintf(stderr, "Error: cannot allocate %zu bytes\n", size);
+		exit(1);
+	}
+	return p;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static uint64_t cycles(void) {
+#if HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// MARK: - Inputs
+
+// Draw N symbols in [0, NSYMBOLS) from distribution DIST, and count them
+static void gen_symbols(int dist, int nsymbols, uint8_t *sym, size_t n,
+			uint32_t *counts) {
+	double cdf[MAX_SYMBOLS];
+	double total = 0;
+	size_t i;
+	int k;
+
+	for (k = 0; k < nsymbols; k++) {
+		double w;
+
+		if (dist == DIST_UNIFORM)
+			w = 1;
+		else if (dist == DIST_SKEWED)
+			w = 1.0 / (k + 1); // Zipf
+		else
+			w = k == 0 ? 9 * (nsymbols - 1) : 1; // 90% on one symbol
+		total += w;
+		cdf[k] = total;
+	}
+	memset(counts, 0, nsymbols * sizeof(*counts));
+	for (i = 0; i < n; i++) {
+		double u = (rng() + 0.5) / 4294967296.0 * total;
+
+		for (k = 0; k < nsymbols - 1 && cdf[k] < u; k++)
+			;
+		sym[i] = (uint8_t)k;
+		counts[k]++;
+	}
+}
+
+// MARK: - Measurements
+
+typedef struct {
+	uint64_t ns, cycles;	// fastest pass
+	size_t ops;		// operations per pass
+} measure;
+
+// Run pass(ARG) until MIN_TIME is reached, and keep the fastest pass
+static measure run(uint32_t (*pass)(void *), void *arg, size_t ops) {
+	measure m = { UINT64_MAX, UINT64_MAX, ops };
+	uint64_t start = now_ns();
+
+	do {
+		uint64_t t = now_ns(), c = cycles();
+
+		sink += pass(arg);
+		c = cycles() - c;
+		t = now_ns() - t;
+		if (t < m.ns) {
+			m.ns = t;
+			m.cycles = c;
+		}
+	} while (now_ns() - start < (uint64_t)(min_time * 1e9));
+	return m;
+}
+
+typedef struct {
+	const fse_config *config;
+	const uint8_t *sym;		// symbols
+	const int32_t *values;		// values for the value stream, or NULL
+	size_t n;
+	uint32_t counts[MAX_SYMBOLS];
+	uint16_t freq[MAX_SYMBOLS];
+	fse_encoder_entry encoder[MAX_SYMBOLS];
+	int32_t decoder[MAX_STATES];
+	fse_value_decoder_entry value_decoder[MAX_STATES];
+	uint8_t *buf;			// encoded stream
+	size_t buf_size, buf_used;
+	fse_state final_state;
+	fse_bit_count final_bits;
+	uint8_t *out;			// decoded symbols
+	int32_t *out_values;		// decoded values
+} fse_bench;
+
+static uint32_t pass_normalize(void *arg) {
+	fse_bench *b = arg;
+	uint16_t freq[MAX_SYMBOLS];
+	uint32_t r = 0;
+	int i;
+
+	for (i = 0; i < TABLE_REPS; i++) {
+		fse_normalize_freq(b->config->nstates, b->config->nsymbols,
+				   b->counts, freq);
+		r += freq[0];
+	}
+	return r;
+}
+
+static uint32_t pass_init_encoder(void *arg) {
+	fse_bench *b = arg;
+	uint32_t r = 0;
+	int i;
+
+	for (i = 0; i < TABLE_REPS; i++) {
+		fse_init_encoder_table(b->config->nstates, b->config->nsymbols,
+				       b->freq, b->encoder);
+		r += b->encoder[i % b->config->nsymbols].k;
+	}
+	return r;
+}
+
+static uint32_t pass_init_decoder(void *arg) {
+	fse_bench *b = arg;
+	uint32_t r = 0;
+	int i;
+
+	for (i = 0; i < TABLE_REPS; i++) {
+		fse_init_decoder_table(b->config->nstates, b->config->nsymbols,
+				       b->freq, b->decoder);
+		r += b->decoder[i % b->config->nstates];
+	}
+	return r;
+}
+
+static uint32_t pass_init_value_decoder(void *arg) {
+	fse_bench *b = arg;
+	uint32_t r = 0;
+	int i;
+
+	for (i = 0; i < TABLE_REPS; i++) {
+		fse_init_value_decoder_table(b->config->nstates,
+					     b->config->nsymbols, b->freq,
+					     b->config->vbits, b->config->vbase,
+					     b->value_decoder);
+		r += b->value_decoder[i % b->config->nstates].total_bits;
+	}
+	return r;
+}
+
+// Encode the symbols backwards, as the LZFSE encoder does, so that they
+// decode forwards
+static uint32_t pass_encode(void *arg) {
+	fse_bench *b = arg;
+	fse_out_stream out;
+	fse_state state = 0;
+	uint8_t *buf = b->buf + STREAM_PADDING;
+	size_t i = b->n;
+
+	fse_out_init(&out);
+	while (i > 0) {
+		size_t k = i < SYMBOLS_PER_FLUSH ? i : SYMBOLS_PER_FLUSH;
+
+		while (k-- > 0) {
+			i--;
+			fse_encode(&state, b->encoder, &out, b->sym[i]);
+		}
+		fse_out_flush(&out, &buf);
+	}
+	fse_out_finish(&out, &buf);
+	b->buf_used = buf - b->buf;
+	b->final_state = state;
+	b->final_bits = out.accum_nbits;
+	return state;
+}
+
+// Same stream shape as pass_encode with the table lookups removed, writing
+// exactly n * log2(nstates) bits
+static uint32_t pass_out_flush(void *arg) {
+	fse_bench *b = arg;
+	fse_out_stream out;
+	uint8_t *buf = b->buf + STREAM_PADDING;
+	int nbits = __builtin_ctz(b->config->nstates);
+	size_t i;
+
+	fse_out_init(&out);
+	for (i = 0; i < b->n; i += SYMBOLS_PER_FLUSH) {
+		int k;
+
+		for (k = 0; k < SYMBOLS_PER_FLUSH; k++)
+			fse_out_push(&out, nbits, (fse_bits)(i + k) & ((1 << nbits) - 1));
+		fse_out_flush(&out, &buf);
+	}
+	fse_out_finish(&out, &buf);
+	b->buf_used = buf - b->buf;
+	b->final_bits = out.accum_nbits;
+	return (uint32_t)b->buf_used;
+}
+
+static uint32_t pass_decode(void *arg) {
+	fse_bench *b = arg;
+	fse_in_stream in;
+	fse_state state = b->final_state;
+	const uint8_t *buf = b->buf + b->buf_used;
+	size_t i;
+
+	if (fse_in_init(&in, b->final_bits, &buf, b->buf) != 0)
+		return 0;
+	for (i = 0; i < b->n; i += SYMBOLS_PER_FLUSH) {
+		int k;
+
+		if (fse_in_flush(&in, &buf, b->buf) != 0)
+			return 0;
+		for (k = 0; k < SYMBOLS_PER_FLUSH && i + k < b->n; k++)
+			b->out[i + k] = fse_decode(&state, b->decoder, &in);
+	}
+	return state;
+}
+
+// Same stream shape as pass_decode with the table lookups removed, reading
+// the stream written by pass_out_flush
+static uint32_t pass_in_flush(void *arg) {
+	fse_bench *b = arg;
+	fse_in_stream in;
+	const uint8_t *buf = b->buf + b->buf_used;
+	int nbits = __builtin_ctz(b->config->nstates);
+	fse_bits acc = 0;
+	size_t i;
+
+	if (fse_in_init(&in, b->final_bits, &buf, b->buf) != 0)
+		return 0;
+	for (i = 0; i + SYMBOLS_PER_FLUSH <= b->n; i += SYMBOLS_PER_FLUSH) {
+		int k;
+
+		if (fse_in_flush(&in, &buf, b->buf) != 0)
+			return 0;
+		for (k = 0; k < SYMBOLS_PER_FLUSH; k++)
+			acc += fse_in_pull(&in, nbits);
+	}
+	return (uint32_t)acc;
+}
+
+// Encode the values backwards: extra bits, then their symbol
+static void encode_values(fse_bench *b) {
+	const fse_config *c = b->config;
+	fse_out_stream out;
+	fse_state state = 0;
+	uint8_t *buf = b->buf + STREAM_PADDING;
+	size_t i = b->n;
+
+	fse_out_init(&out);
+	while (i > 0) {
+		size_t k = i < VALUES_PER_FLUSH ? i : VALUES_PER_FLUSH;
+
+		while (k-- > 0) {
+			uint8_t s = b->sym[--i];
+
+			fse_out_push(&out, c->vbits[s], b->values[i] - c->vbase[s]);
+			fse_encode(&state, b->encoder, &out, s);
+		}
+		fse_out_flush(&out, &buf);
+	}
+	fse_out_finish(&out, &buf);
+	b->buf_used = buf - b->buf;
+	b->final_state = state;
+	b->final_bits = out.accum_nbits;
+}
+
+static uint32_t pass_value_decode(void *arg) {
+	fse_bench *b = arg;
+	fse_in_stream in;
+	fse_state state = b->final_state;
+	const uint8_t *buf = b->buf + b->buf_used;
+	size_t i;
+
+	if (fse_in_init(&in, b->final_bits, &buf, b->buf) != 0)
+		return 0;
+	for (i = 0; i < b->n; i += VALUES_PER_FLUSH) {
+		int k;
+
+		if (fse_in_flush(&in, &buf, b->buf) != 0)
+			return 0;
+		for (k = 0; k < VALUES_PER_FLUSH && i + k < b->n; k++)
+			b->out_values[i + k] =
+				fse_value_decode(&state, b->value_decoder, &in);
+	}
+	return state;
+}
+
+// MARK: - Main
+
+static void print_header(void) {
+	printf("%-18s %-7s %6s %7s %-8s %10s %10s\n", "primitive", "table",
+	       "states", "symbols", "dist", "ns/op", "cycles/op");
+}
+
+static void print_measure(const char *primitive, const fse_config *c,
+			  int dist, measure m) {
+	printf("%-18s %-7s %6d %7d %-8s %10.3f", primitive, c->name, c->nstates,
+	       c->nsymbols, dist_names[dist], (double)m.ns / m.ops);
+	if (HAVE_TSC)
+		printf(" %10.2f\n", (double)m.cycles / m.ops);
+	else
+		printf(" %10s\n", "-");
+	fflush(stdout);
+}
+
+static void check(int ok, const char *what, const fse_config *c, int dist) {
+	if (!ok) {
+		fprintf(stderr, "Error: %s round trip failed (%s, %s)\n", what,
+			c->name, dist_names[dist]);
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv) {
+	size_t n = 65536;
+	fse_bench *b = xmalloc(sizeof(*b));
+	size_t ci, i;
+	int dist, a;
+
+	for (a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "-h") == 0) {
+			usage(argv[0]);
+			return 0;
+		} else if (strcmp(argv[a], "-n") == 0 && a + 1 < argc) {
+			n = strtoul(argv[++a], NULL, 0);
+		} else if (strcmp(argv[a], "-t") == 0 && a + 1 < argc) {
+			min_time = atof(argv[++a]);
+		} else {
+			usage(argv[0]);
+			fprintf(stderr, "Error: invalid flag or missing arg %s\n",
+				argv[a]);
+			return 1;
+		}
+	}
+	if (n == 0) {
+		fprintf(stderr, "Error: invalid symbol count\n");
+		return 1;
+	}
+
+	memset(b, 0, sizeof(*b));
+	b->n = n;
+	b->buf_size = 4 * n + 64; // 23 bits per value at most, plus padding
+	b->buf = xmalloc(b->buf_size);
+	memset(b->buf, 0, STREAM_PADDING);
+	b->out = xmalloc(n);
+	b->out_values = xmalloc(n * sizeof(*b->out_values));
+	{
+		uint8_t *sym = xmalloc(n);
+		int32_t *values = xmalloc(n * sizeof(*values));
+
+		printf("FSE_IOSTREAM_64=%d, %zu symbols per pass; ops are "
+		       "table builds, or symbols (flush: one push)\n",
+		       FSE_IOSTREAM_64, n);
+		print_header();
+		for (ci = 0; ci < N_CONFIGS; ci++)
+			for (dist = 0; dist < N_DISTS; dist++) {
+				const fse_config *c = &configs[ci];
+
+				b->config = c;
+				b->sym = sym;
+				b->values = values;
+				gen_symbols(dist, c->nsymbols, sym, n, b->counts);
+				fse_normalize_freq(c->nstates, c->nsymbols,
+						   b->counts, b->freq);
+				fse_init_encoder_table(c->nstates, c->nsymbols,
+						       b->freq, b->encoder);
+				fse_init_decoder_table(c->nstates, c->nsymbols,
+						       b->freq, b->decoder);
+
+				// Tables
+				print_measure("fse_normalize_freq", c, dist,
+					      run(pass_normalize, b, TABLE_REPS));
+				print_measure("init_encoder_table", c, dist,
+					      run(pass_init_encoder, b, TABLE_REPS));
+				print_measure("init_decoder_table", c, dist,
+					      run(pass_init_decoder, b, TABLE_REPS));
+
+				// Symbol stream
+				print_measure("fse_encode", c, dist,
+					      run(pass_encode, b, n));
+				pass_decode(b);
+				check(memcmp(b->out, sym, n) == 0, "symbol", c,
+				      dist);
+				print_measure("fse_decode", c, dist,
+					      run(pass_decode, b, n));
+				print_measure("fse_out_flush", c, dist,
+					      run(pass_out_flush, b, n));
+				print_measure("fse_in_flush", c, dist,
+					      run(pass_in_flush, b, n));
+
+				// Value stream, for the L, M and D tables only
+				if (c->vbits == NULL)
+					continue;
+				print_measure("init_value_decoder", c, dist,
+					      run(pass_init_value_decoder, b,
+						  TABLE_REPS));
+				for (i = 0; i < n; i++)
+					values[i] = c->vbase[sym[i]] +
+						    (int32_t)(rng() &
+							      ((1U << c->vbits[sym[i]]) - 1));
+				encode_values(b);
+				pass_value_decode(b);
+				check(memcmp(b->out_values, values,
+					     n * sizeof(*values)) == 0,
+				      "value", c, dist);
+				print_measure("fse_value_decode", c, dist,
+					      run(pass_value_decode, b, n));
+			}
+		free(values);
+		free(sym);
+	}
+
+	free(b->out_values);
+	free(b->out);
+	free(b->buf);
+	free(b);
+	return 0;
+}
@@ -0,0 +1,365 @@
+/*
+  Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+  2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+  in the documentation and/or other materials provided with the distribution.
+
+  3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Inspector for LZFSE streams: walks the blocks of a compressed stream and
+// prints their headers, the entropy of their frequency tables, and the time
+// the decoder spends on each of them.
+
+#include "lzfse.h"
+#include "lzfse_internal.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+	size_t offset;		// in the compressed stream
+	size_t raw_offset;	// in the decoded output
+	lzfse_block_info info;
+	uint64_t decode_ns;	// fastest decode of the block
+} block;
+
+static void usage(const char *argv0) {
+	fprintf(stderr,
+		"Usage: %s [-n iterations] [-v] [-h] [input_file]\n"
+		"  -n  decode each block this many times and keep the fastest (default: 1)\n"
+		"  -v  also print the L, M, D and literal frequency tables\n"
+		"Reads the compressed stream from stdin when input_file is omitted.\n",
+		argv0);
+}
+
+static void *xmalloc(size_t size) {
+	void *p = malloc(size ? size : 1);
+
+	if (p == NULL) {
+		fprintf(stderr, "Error: cannot allocate %zu bytes\n", size);
+		exit(1);
+	}
+	return p;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+// Read all of F. Return the data and store its size in *SIZE.
+static uint8_t *read_all(FILE *f, size_t *size) {
+	size_t allocated = 1 << 20, n = 0;
+	uint8_t *data = xmalloc(allocated);
+
+	for (;;) {
+		size_t r = fread(data + n, 1, allocated - n, f);
+
+		n += r;
+		if (n < allocated)
+			break;
+		allocated *= 2;
+		data = realloc(data, allocated);
+		if (data == NULL) {
+			fprintf(stderr, "Error: cannot allocate %zu bytes\n", allocated);
+			exit(1);
+		}
+	}
+	if (ferror(f)) {
+		perror("read");
+		exit(1);
+	}
+	*size = n;
+	return data;
+}
+
+static const char *magic_name(uint32_t magic) {
+	switch (magic) {
+	case LZFSE_ENDOFSTREAM_BLOCK_MAGIC:
+		return "bvx$";
+	case LZFSE_UNCOMPRESSED_BLOCK_MAGIC:
+		return "bvx-";
+	case LZFSE_COMPRESSEDV1_BLOCK_MAGIC:
+		return "bvx1";
+	case LZFSE_COMPRESSEDV2_BLOCK_MAGIC:
+		return "bvx2";
+	case LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC:
+		return "bvxn";
+	}
+	return "?";
+}
+
+// Shannon entropy in bits/symbol of a normalized frequency table
+static double entropy(const uint16_t *freq, int n_symbols, int n_states) {
+	double h = 0;
+	int i;
+
+	for (i = 0; i < n_symbols; i++)
+		if (freq[i]) {
+			double p = (double)freq[i] / n_states;
+			h -= p * log2(p);
+		}
+	return h;
+}
+
+static void print_freq(const char *name, const uint16_t *freq, int n_symbols,
+		       int n_states) {
+	int i, col = 0;
+
+	printf("    %-7s H=%.2f bits:", name, entropy(freq, n_symbols, n_states));
+	for (i = 0; i < n_symbols; i++) {
+		if (freq[i] == 0)
+			continue;
+		if (col++ % 12 == 0)
+			printf("\n     ");
+		printf(" %3d:%4u", i, freq[i]);
+	}
+	printf("\n");
+}
+
+// Walk the block headers of SRC into BLOCKS. Return the number of blocks,
+// the end of stream block included, or exit on a malformed stream.
+static size_t walk(const uint8_t *src, size_t src_size, block **blocks,
+		   size_t *raw_size) {
+	size_t allocated = 64, n = 0, offset = 0, raw = 0;
+	block *b = xmalloc(allocated * sizeof(*b));
+
+	for (;;) {
+		lzfse_block_info info;
+		int status = lzfse_decode_block_info(src + offset,
+						     src_size - offset, &info);
+
+		if (status != LZFSE_STATUS_OK ||
+		    info.header_size + (size_t)info.n_payload_bytes >
+			    src_size - offset) {
+			fprintf(stderr, "Error: %s block at offset %zu\n",
+				status == LZFSE_STATUS_ERROR ? "invalid"
+							     : "truncated",
+				offset);
+			exit(1);
+		}
+		if (n == allocated) {
+			allocated *= 2;
+			b = realloc(b, allocated * sizeof(*b));
+			if (b == NULL) {
+				fprintf(stderr, "Error: out of memory\n");
+				exit(1);
+			}
+		}
+		b[n].offset = offset;
+		b[n].raw_offset = raw;
+		b[n].info = info;
+		b[n].decode_ns = 0;
+		n++;
+		offset += info.header_size + info.n_payload_bytes;
+		raw += info.n_raw_bytes;
+		if (info.magic == LZFSE_ENDOFSTREAM_BLOCK_MAGIC)
+			break;
+	}
+	if (offset < src_size)
+		fprintf(stderr, "Warning: %zu bytes after the end of stream\n",
+			src_size - offset);
+	*blocks = b;
+	*raw_size = raw;
+	return n;
+}
+
+// Decode each block on its own with the streaming decoder, ITERATIONS times,
+// and keep the fastest time. Blocks are decoded in stream order, so matches
+// and frequency table reuse see the same state as in a regular decode.
+static void time_blocks(const uint8_t *src, block *blocks, size_t n_blocks,
+			uint8_t *dst, size_t dst_size, int iterations) {
+	lzfse_decoder_state *s = xmalloc(lzfse_decode_scratch_size());
+	size_t i;
+	int k;
+
+	memset(s, 0x00, sizeof(*s));
+	s->src_begin = src;
+	s->dst_begin = dst;
+	s->dst_end = dst + dst_size;
+	for (i = 0; i < n_blocks; i++) {
+		const block *b = &blocks[i];
+		const uint8_t *block_end =
+			src + b->offset + b->info.header_size + b->info.n_payload_bytes;
+		uint64_t best = UINT64_MAX;
+
+		for (k = 0; k < iterations; k++) {
+			uint64_t t;
+			int status;
+
+			s->src = src + b->offset;
+			s->src_end = block_end;
+			s->dst = dst + b->raw_offset;
+			t = now_ns();
+			status = lzfse_decode(s);
+			t = now_ns() - t;
+			// Past a block, the decoder waits for the next magic
+			if ((status != LZFSE_STATUS_SRC_EMPTY &&
+			     status != LZFSE_STATUS_OK) ||
+			    s->src != block_end ||
+			    s->dst != dst + b->raw_offset + b->info.n_raw_bytes) {
+				fprintf(stderr,
+					"Error: decode failed in block %zu at offset %zu\n",
+					i, b->offset);
+				exit(1);
+			}
+			if (t < best)
+				best = t;
+		}
+		blocks[i].decode_ns = best;
+	}
+	free(s);
+}
+
+int main(int argc, char **argv) {
+	const char *in_file = NULL;
+	int iterations = 1;
+	int verbose = 0;
+	uint8_t *src, *dst;
+	size_t src_size, raw_size, n_blocks, i;
+	block *blocks;
+	size_t count[5] = { 0 }, raw[5] = { 0 }, enc[5] = { 0 };
+	uint64_t ns[5] = { 0 };
+	static const uint32_t magics[5] = {
+		LZFSE_COMPRESSEDV2_BLOCK_MAGIC, LZFSE_COMPRESSEDV1_BLOCK_MAGIC,
+		LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC, LZFSE_UNCOMPRESSED_BLOCK_MAGIC,
+		LZFSE_ENDOFSTREAM_BLOCK_MAGIC
+	};
+	uint64_t total_ns = 0;
+
+	for (i = 1; i < (size_t)argc; i++) {
+		const char *a = argv[i];
+
+		if (strcmp(a, "-h") == 0) {
+			usage(argv[0]);
+			return 0;
+		} else if (strcmp(a, "-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(a, "-n") == 0 && i + 1 < (size_t)argc) {
+			iterations = atoi(argv[++i]);
+			if (iterations < 1) {
+				fprintf(stderr, "Error: invalid iterations %s\n",
+					argv[i]);
+				return 1;
+			}
+		} else if (a[0] != '-' && in_file == NULL) {
+			in_file = a;
+		} else {
+			usage(argv[0]);
+			fprintf(stderr, "Error: invalid flag or missing arg %s\n", a);
+			return 1;
+		}
+	}
+
+	if (in_file) {
+		FILE *f = fopen(in_file, "rb");
+
+		if (f == NULL) {
+			perror(in_file);
+			return 1;
+		}
+		src = read_all(f, &src_size);
+		fclose(f);
+	} else {
+		src = read_all(stdin, &src_size);
+	}
+
+	n_blocks = walk(src, src_size, &blocks, &raw_size);
+	dst = xmalloc(raw_size);
+	time_blocks(src, blocks, n_blocks, dst, raw_size, iterations);
+
+	printf("%5s %10s %5s %8s %8s %6s %6s %7s %4s %4s %6s %6s %9s %8s\n",
+	       "block", "offset", "magic", "raw", "payload", "header", "lits",
+	       "matches", "lbit", "mbit", "b/lit", "b/lmd", "dec us", "MB/s");
+	for (i = 0; i < n_blocks; i++) {
+		const block *b = &blocks[i];
+		const lzfse_block_info *info = &b->info;
+		int lzfse = info->magic == LZFSE_COMPRESSEDV1_BLOCK_MAGIC ||
+			    info->magic == LZFSE_COMPRESSEDV2_BLOCK_MAGIC;
+		int k;
+
+		printf("%5zu %10zu %5s %8u %8u %6u", i, b->offset,
+		       magic_name(info->magic), info->n_raw_bytes,
+		       info->n_payload_bytes, info->header_size);
+		if (lzfse)
+			printf(" %6u %7u %4d %4d %6.2f %6.2f", info->n_literals,
+			       info->n_matches, info->literal_bits,
+			       info->lmd_bits,
+			       info->n_literals ? 8.0 * info->n_literal_payload_bytes /
+							  info->n_literals
+						: 0,
+			       info->n_matches ? 8.0 * info->n_lmd_payload_bytes /
+							 info->n_matches
+					       : 0);
+		else
+			printf(" %6s %7s %4s %4s %6s %6s", "-", "-", "-", "-", "-",
+			       "-");
+		printf(" %9.1f %8.1f\n", b->decode_ns * 1e-3,
+		       b->decode_ns ? info->n_raw_bytes * 1e3 / b->decode_ns : 0);
+
+		if (verbose && lzfse) {
+			lzfse_block_freq freq;
+
+			if (lzfse_decode_block_freq(src + b->offset,
+						    src_size - b->offset,
+						    &freq) == LZFSE_STATUS_OK) {
+				print_freq("L", freq.l_freq, LZFSE_ENCODE_L_SYMBOLS,
+					   LZFSE_ENCODE_L_STATES);
+				print_freq("M", freq.m_freq, LZFSE_ENCODE_M_SYMBOLS,
+					   LZFSE_ENCODE_M_STATES);
+				print_freq("D", freq.d_freq, LZFSE_ENCODE_D_SYMBOLS,
+					   LZFSE_ENCODE_D_STATES);
+				print_freq("literal", freq.literal_freq,
+					   LZFSE_ENCODE_LITERAL_SYMBOLS,
+					   LZFSE_ENCODE_LITERAL_STATES);
+			}
+		}
+
+		for (k = 0; k < 5; k++)
+			if (magics[k] == info->magic) {
+				count[k]++;
+				raw[k] += info->n_raw_bytes;
+				enc[k] += info->header_size + info->n_payload_bytes;
+				ns[k] += b->decode_ns;
+			}
+		total_ns += b->decode_ns;
+	}
+
+	printf("\n%5s %8s %12s %12s %7s %10s %8s\n", "magic", "blocks", "raw",
+	       "encoded", "ratio", "dec us", "MB/s");
+	for (i = 0; i < 5; i++) {
+		if (count[i] == 0)
+			continue;
+		printf("%5s %8zu %12zu %12zu %7.3f %10.1f %8.1f\n",
+		       magic_name(magics[i]), count[i], raw[i], enc[i],
+		       enc[i] ? (double)raw[i] / enc[i] : 0, ns[i] * 1e-3,
+		       ns[i] ? raw[i] * 1e3 / ns[i] : 0);
+	}
+	printf("%5s %8zu %12zu %12zu %7.3f %10.1f %8.1f\n", "total", n_blocks,
+	       raw_size, src_size, src_size ? (double)raw_size / src_size : 0,
+	       total_ns * 1e-3, total_ns ? raw_size * 1e3 / total_ns : 0);
+
+	free(blocks);
+	free(dst);
+	free(src);
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:  
+
+1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+    in the documentation and/or other materials provided with the distribution.
+
+3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// LZFSE encoder stage cycle counters, see LZFSE_INSTRUMENT in lzfse_internal.h
+
+#ifdef __KERNEL__
+#include <linux/module.h>
+#endif
+
+#include "lzfse.h"
+#include "lzfse_internal.h"
+
+static const char *const lzfse_instrument_stage_names[LZFSE_STAGES] = {
+    "other", "match_search", "histogram",   "tables",   "literals",
+    "lmd",   "header",       "lzvn_search", "lzvn_emit"};
+
+#if LZFSE_INSTRUMENT
+
+#ifdef __KERNEL__
+DEFINE_PER_CPU(lzfse_instrument_counters, lzfse_instrument_pcpu);
+#else
+_Thread_local lzfse_instrument_counters lzfse_instrument_tls;
+#endif
+
+void lzfse_instrument_read(uint64_t cycles[LZFSE_STAGES]) {
+  int i;
+#ifdef __KERNEL__
+  int cpu;
+
+  memset(cycles, 0x00, LZFSE_STAGES * sizeof(uint64_t));
+  for_each_possible_cpu(cpu) {
+    const lzfse_instrument_counters *st =
+        per_cpu_ptr(&lzfse_instrument_pcpu, cpu);
+    for (i = 0; i < LZFSE_STAGES; i++)
+      cycles[i] += st->cycles[i];
+  }
+#else
+  for (i = 0; i < LZFSE_STAGES; i++)
+    cycles[i] = lzfse_instrument_tls.cycles[i];
+#endif
+}
+
+void lzfse_instrument_reset(void) {
+#ifdef __KERNEL__
+  int cpu;
+
+  for_each_possible_cpu(cpu)
+    memset(per_cpu_ptr(&lzfse_instrument_pcpu, cpu)->cycles, 0x00,
+           LZFSE_STAGES * sizeof(uint64_t));
+#else
+  memset(lzfse_instrument_tls.cycles, 0x00,
+         sizeof(lzfse_instrument_tls.cycles));
+#endif
+}
+
+#else // !LZFSE_INSTRUMENT
+
+void lzfse_instrument_read(uint64_t cycles[LZFSE_STAGES]) {
+  memset(cycles, 0x00, LZFSE_STAGES * sizeof(uint64_t));
+}
+
+void lzfse_instrument_reset(void) {}
+
+#endif // !LZFSE_INSTRUMENT
+
+const char *lzfse_instrument_stage_name(int stage) {
+  if (stage < 0 || stage >= LZFSE_STAGES)
+    return "unknown";
+  return lzfse_instrument_stage_names[stage];
+}
+
+EXPORT_SYMBOL(lzfse_instrument_read);
+EXPORT_SYMBOL(lzfse_instrument_reset);
+EXPORT_SYMBOL(lzfse_instrument_stage_name);
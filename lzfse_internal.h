@@ -28,9 +28,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 //  incompatible.
 
 
-#include <linux/stddef.h>
-#include <linux/types.h>
-
+#include "lzfse_compat.h"
 #include "lzvn.h"
 #include "lzfse.h"
 #include "lzfse_fse.h"
@@ -91,6 +89,22 @@ LZFSE_INLINE int __builtin_ctzll(uint64_t val) {
 #define LZFSE_COMPRESSEDV1_BLOCK_MAGIC   0x31787662 // bvx1 (lzfse compressed, uncompressed tables)
 #define LZFSE_COMPRESSEDV2_BLOCK_MAGIC   0x32787662 // bvx2 (lzfse compressed, compressed tables)
 #define LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC 0x6e787662 // bvxn (lzvn compressed)
+#define LZFSE_CLUSTER_MAGIC              0x31637a6c // lzc1 (page cluster)
+
+/*! @abstract Page cluster header, see lzfse_cluster_encode. It is followed by
+ *  n_groups + 1 uint32_t offsets of the group streams, counted from the end
+ *  of the offset table, the last one being the total size of the streams.
+ *  Each group of restart_interval pages (fewer for the last group) is a
+ *  regular LZFSE stream. */
+typedef struct {
+  //  Magic number, always LZFSE_CLUSTER_MAGIC.
+  uint32_t magic;
+  //  Number of pages, and size of each page in bytes.
+  uint32_t n_pages;
+  uint32_t page_size;
+  //  Number of pages sharing history in each group.
+  uint32_t restart_interval;
+} lzfse_cluster_header;
 
 /*! @abstract Uncompressed block header in encoder stream. */
 typedef struct {
@@ -231,6 +245,16 @@ LZFSE_INLINE void copy16(void *dst, const void *src) {
   store8(dst, m0);
   store8((unsigned char *)dst + 8, m1);
 }
+LZFSE_INLINE void copy32(void *dst, const void *src) {
+  uint64_t m0 = load8(src);
+  uint64_t m1 = load8((const unsigned char *)src + 8);
+  uint64_t m2 = load8((const unsigned char *)src + 16);
+  uint64_t m3 = load8((const unsigned char *)src + 24);
+  store8(dst, m0);
+  store8((unsigned char *)dst + 8, m1);
+  store8((unsigned char *)dst + 16, m2);
+  store8((unsigned char *)dst + 24, m3);
+}
 
 // ===============================================================
 // Bitfield Operations
@@ -331,6 +355,132 @@ LZFSE_INLINE int lzfse_check_block_header_v1(
   return 0; // OK
 }
 
+// MARK: - Statistics
+
+/*! @abstract Usage counters, kept per CPU in the kernel and reported in
+ *  /sys/kernel/debug/lzfse/stats. Userspace builds do not count.
+ *
+ *  Each call is counted with the blocks of the stream it returned or decoded.
+ *  lzfse_cluster_encode and lzfse_cluster_decode(_page) count one call per
+ *  group stream. Not counted: lzfse_validate_buffer, the page API, the LZVN
+ *  and streaming functions, and decode calls rejected before decoding. */
+typedef struct {
+  //  lzfse_encode_buffer, lzfse_encode_buffer_level and lzfse_encode_segments
+  //  calls, and how their output was produced
+  uint64_t encode_calls;
+  uint64_t encode_bytes_in;
+  uint64_t encode_bytes_out;
+  uint64_t encode_ns;
+  uint64_t encode_lzvn;         // input small enough for the LZVN path
+  uint64_t encode_chunked;      // input large enough for the chunked path
+  uint64_t encode_uncompressed; // fell back to an uncompressed block
+  uint64_t encode_failed;       // returned 0
+  uint64_t encode_blocks[LZFSE_STAT_BLOCK_TYPES]; // in returned streams
+
+  //  lzfse_decode_buffer (and its _cached, _trusted and _inplace variants),
+  //  lzfse_decode_range and lzfse_decode_segments calls, and how they ended
+  uint64_t decode_calls;
+  uint64_t decode_bytes_in;
+  uint64_t decode_bytes_out;
+  uint64_t decode_ns;
+  uint64_t decode_dst_full;
+  uint64_t decode_errors;
+  uint64_t decode_blocks[LZFSE_STAT_BLOCK_TYPES];
+} lzfse_stats;
+
+#ifdef __KERNEL__
+DECLARE_PER_CPU(lzfse_stats, lzfse_stats_pcpu);
+#define LZFSE_STAT_ADD(field, n) this_cpu_add(lzfse_stats_pcpu.field, (n))
+#define LZFSE_STAT_TIME() ktime_get_ns()
+#else
+#define LZFSE_STAT_ADD(field, n) ((void)sizeof(n))
+#define LZFSE_STAT_TIME() ((uint64_t)0)
+#endif
+#define LZFSE_STAT_INC(field) LZFSE_STAT_ADD(field, 1)
+
+// MARK: - Instrumentation
+
+#ifndef LZFSE_INSTRUMENT
+#define LZFSE_INSTRUMENT 0
+#endif
+
+#if LZFSE_INSTRUMENT
+
+//  Cycles charged to each stage
+typedef struct {
+  uint64_t cycles[LZFSE_STAGES];
+} lzfse_instrument_counters;
+
+#ifdef __KERNEL__
+DECLARE_PER_CPU(lzfse_instrument_counters, lzfse_instrument_pcpu);
+//  Only the deltas are shared, and this_cpu_add is safe with preemption
+//  enabled. A stage that is preempted or migrated still counts the elapsed
+//  cycles, charged to the CPU it ends on.
+#define LZFSE_INSTRUMENT_ADD(stage, n)                                         \
+  this_cpu_add(lzfse_instrument_pcpu.cycles[stage], (n))
+#define LZFSE_INSTRUMENT_CYCLES() ((uint64_t)get_cycles())
+#else
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LZFSE_INSTRUMENT_CYCLES() ((uint64_t)__rdtsc())
+#else
+#include <time.h>
+LZFSE_INLINE uint64_t lzfse_instrument_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+#define LZFSE_INSTRUMENT_CYCLES() lzfse_instrument_ns()
+#endif
+extern _Thread_local lzfse_instrument_counters lzfse_instrument_tls;
+#define LZFSE_INSTRUMENT_ADD(stage, n)                                         \
+  (lzfse_instrument_tls.cycles[stage] += (n))
+#endif
+
+//  Charge the cycles since the last switch to the stage *CURRENT, unless it is
+//  LZFSE_STAGE_OTHER, then make STAGE current and return the previous stage.
+//  The stage being timed and its start live in the encoder state, so that
+//  concurrent encoders on a CPU do not mix up their stages, and time spent
+//  outside of the encoder is never charged.
+LZFSE_INLINE int lzfse_stage_switch(int *current, uint64_t *start, int stage) {
+  uint64_t now = LZFSE_INSTRUMENT_CYCLES();
+  int prev = *current;
+
+  if (prev != LZFSE_STAGE_OTHER)
+    LZFSE_INSTRUMENT_ADD(prev, now - *start);
+  *start = now;
+  *current = stage;
+  return prev;
+}
+
+//  int prev = LZFSE_STAGE_ENTER(s, stage); ... LZFSE_STAGE_LEAVE(s, prev);
+//  S is an lzfse_encoder_state or lzvn_encoder_state. Stages nest: LEAVE goes
+//  back to timing the enclosing stage, or stops timing at the outermost one.
+#define LZFSE_STAGE_ENTER(s, stage)                                            \
+  lzfse_stage_switch(&(s)->instrument_stage, &(s)->instrument_start, (stage))
+#define LZFSE_STAGE_SWITCH(s, stage) ((void)LZFSE_STAGE_ENTER(s, stage))
+#define LZFSE_STAGE_LEAVE(s, prev) ((void)LZFSE_STAGE_ENTER(s, prev))
+
+#else // !LZFSE_INSTRUMENT
+
+#define LZFSE_STAGE_ENTER(s, stage) LZFSE_STAGE_OTHER
+#define LZFSE_STAGE_SWITCH(s, stage) ((void)0)
+#define LZFSE_STAGE_LEAVE(s, prev) ((void)(prev))
+
+#endif // !LZFSE_INSTRUMENT
+
+// MARK: - Tracing
+
+//  Paths reported by the lzfse_encode_fallback tracepoint
+enum {
+  LZFSE_TRACE_PATH_LZVN = 0,     // input below LZFSE_ENCODE_LZVN_THRESHOLD
+  LZFSE_TRACE_PATH_CHUNKED,      // input too large for 32-bit offsets
+  LZFSE_TRACE_PATH_UNCOMPRESSED, // stored as an uncompressed block
+  LZFSE_TRACE_PATH_FAILED,       // output does not fit
+};
+
+#include "lzfse_trace.h"
+
 // MARK: - L, M, D encoding constants for LZFSE
 
 //  Largest encodable L (literal length), M (match length) and D (match
@@ -339,6 +489,16 @@ LZFSE_INLINE int lzfse_check_block_header_v1(
 #define LZFSE_ENCODE_MAX_M_VALUE 2359
 #define LZFSE_ENCODE_MAX_D_VALUE 262139
 
+//  Early abort: number of new literals between two output size checks
+#define LZFSE_ENCODE_EARLY_ABORT_INTERVAL 256
+
+//  Segmented buffers: size of the contiguous window used by the encoder and
+//  decoder, and the history kept when it slides. The history covers the
+//  largest match distance, plus the pending literals and match of the encoder.
+#define LZFSE_SEGMENT_WINDOW_SIZE (1 << 20)
+#define LZFSE_SEGMENT_HISTORY_SIZE (1 << 19)
+#define LZFSE_SEGMENT_CHUNK_SIZE (1 << 18)
+
 /*! @abstract The L, M, D data streams are all encoded as a "base" value, which is
  * FSE-encoded, and an "extra bits" value, which is the difference between
  * value and base, and is simply represented as a raw bit value (because it
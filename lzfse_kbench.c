@@ -0,0 +1,385 @@
+/*
+  Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+  2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+  in the documentation and/or other materials provided with the distribution.
+
+  3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// LZFSE in-kernel benchmark, in the spirit of tcrypt.
+//
+// Runs lzfse_encode_buffer and lzfse_decode_buffer on each online CPU for the
+// configured buffer sizes, at load time and whenever "1" is written to
+// /sys/kernel/debug/lzfse_bench/trigger. Throughput and log2 latency
+// histograms are published in /sys/kernel/debug/lzfse_bench/results.
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#include "lzfse.h"
+
+#define LZFSE_KBENCH_MAX_SIZES 8
+#define LZFSE_KBENCH_MAX_SIZE (64 << 20)
+#define LZFSE_KBENCH_HIST_BUCKETS 40 // log2 of the latency in ns
+
+static unsigned int sizes[LZFSE_KBENCH_MAX_SIZES] = { 4096, 65536, 1048576 };
+static int n_sizes = 3;
+module_param_array(sizes, uint, &n_sizes, 0644);
+MODULE_PARM_DESC(sizes, "Buffer sizes in bytes (default: 4096,65536,1048576)");
+
+static unsigned int iterations = 100;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Calls per CPU, size and operation (default: 100)");
+
+static char *data = "text";
+module_param(data, charp, 0444);
+MODULE_PARM_DESC(data,
+		 "Input data: text, random or zeros, set at load (default: text)");
+
+static bool alloc_per_call;
+module_param(alloc_per_call, bool, 0644);
+MODULE_PARM_DESC(alloc_per_call,
+		 "vmalloc the scratch buffer in every call (default: N)");
+
+static bool run_on_load = true;
+module_param(run_on_load, bool, 0444);
+MODULE_PARM_DESC(run_on_load, "Run the benchmark at load time (default: Y)");
+
+enum { LZFSE_KBENCH_ENCODE = 0, LZFSE_KBENCH_DECODE };
+static const char *const lzfse_kbench_ops[2] = { "encode", "decode" };
+
+struct lzfse_kbench_stat {
+	u64 calls;
+	u64 bytes;
+	u64 ns;
+	u64 min_ns;
+	u64 max_ns;
+	u32 hist[LZFSE_KBENCH_HIST_BUCKETS];
+};
+
+struct lzfse_kbench_result {
+	unsigned int size;
+	size_t compressed_size;
+	struct lzfse_kbench_stat op[2];
+};
+
+// Buffers shared by the per-CPU runs, which are sequential
+struct lzfse_kbench_ctx {
+	int cpu;
+	int n_sizes;
+	unsigned int sizes[LZFSE_KBENCH_MAX_SIZES]; // checked copy of the param
+	uint8_t *src;
+	uint8_t *enc;
+	uint8_t *dec;
+	void *scratch;
+	size_t enc_capacity;
+};
+
+static DEFINE_MUTEX(lzfse_kbench_lock);
+// Results of the last run, indexed by cpu * LZFSE_KBENCH_MAX_SIZES + size
+static struct lzfse_kbench_result *lzfse_kbench_results;
+static int lzfse_kbench_n_sizes;
+static u64 lzfse_kbench_runs;
+static struct dentry *lzfse_kbench_dir;
+
+static const char *const lzfse_kbench_words[] = {
+	"the", "of", "and", "to", "in", "a", "is", "that", "for", "it",
+	"compression", "buffer", "stream", "block", "literal", "match",
+	"distance", "entropy", "kernel", "module", "storage", "request",
+};
+
+//  Fill P with N bytes of the selected input data
+static void lzfse_kbench_fill(uint8_t *p, size_t n) {
+	u64 x = 0x9e3779b97f4a7c15ULL;
+	size_t i = 0;
+
+	if (strcmp(data, "zeros") == 0) {
+		memset(p, 0, n);
+		return;
+	}
+	if (strcmp(data, "random") == 0) {
+		get_random_bytes(p, n);
+		return;
+	}
+
+	// Text from a small vocabulary, deterministic across runs
+	while (i < n) {
+		const char *w;
+
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		w = lzfse_kbench_words[(x >> 32) %
+				       ARRAY_SIZE(lzfse_kbench_words)];
+		while (*w && i < n)
+			p[i++] = *w++;
+		if (i < n)
+			p[i++] = ((x >> 8) & 15) ? ' ' : '\n';
+	}
+}
+
+static void lzfse_kbench_record(struct lzfse_kbench_stat *s, u64 ns,
+				size_t bytes) {
+	unsigned int b = ns ? ilog2(ns) : 0;
+
+	if (b >= LZFSE_KBENCH_HIST_BUCKETS)
+		b = LZFSE_KBENCH_HIST_BUCKETS - 1;
+	s->hist[b]++;
+	if (s->calls == 0 || ns < s->min_ns)
+		s->min_ns = ns;
+	if (ns > s->max_ns)
+		s->max_ns = ns;
+	s->calls++;
+	s->bytes += bytes;
+	s->ns += ns;
+}
+
+//  Run one operation ITERATIONS times on SIZE bytes and record the latencies.
+//  Return the output size of the last call, or 0 on failure.
+static size_t lzfse_kbench_op(struct lzfse_kbench_ctx *ctx, int op,
+			      size_t size, size_t enc_size,
+			      struct lzfse_kbench_stat *s) {
+	size_t scratch_size = op == LZFSE_KBENCH_ENCODE
+				      ? lzfse_encode_scratch_size()
+				      : lzfse_decode_scratch_size();
+	size_t out = 0;
+	unsigned int i;
+
+	for (i = 0; i < iterations; i++) {
+		void *scratch = ctx->scratch;
+		u64 t = ktime_get_ns();
+
+		if (alloc_per_call) {
+			scratch = vmalloc(scratch_size);
+			if (scratch == NULL)
+				return 0;
+		}
+		if (op == LZFSE_KBENCH_ENCODE)
+			out = lzfse_encode_buffer(ctx->enc, ctx->enc_capacity,
+						  ctx->src, size, scratch);
+		else
+			out = lzfse_decode_buffer(ctx->dec, size, ctx->enc,
+						  enc_size, scratch);
+		if (alloc_per_call)
+			vfree(scratch);
+		lzfse_kbench_record(s, ktime_get_ns() - t, size);
+		cond_resched();
+	}
+	return out;
+}
+
+//  Benchmark all sizes on the current CPU, called through work_on_cpu
+static long lzfse_kbench_cpu(void *arg) {
+	struct lzfse_kbench_ctx *ctx = arg;
+	int j;
+
+	for (j = 0; j < ctx->n_sizes; j++) {
+		struct lzfse_kbench_result *r =
+			&lzfse_kbench_results[ctx->cpu * LZFSE_KBENCH_MAX_SIZES + j];
+		size_t size = ctx->sizes[j];
+		size_t enc_size;
+
+		r->size = ctx->sizes[j];
+		enc_size = lzfse_kbench_op(ctx, LZFSE_KBENCH_ENCODE, size, 0,
+					   &r->op[LZFSE_KBENCH_ENCODE]);
+		if (enc_size == 0)
+			return -ENOMEM;
+		r->compressed_size = enc_size;
+		if (lzfse_kbench_op(ctx, LZFSE_KBENCH_DECODE, size, enc_size,
+				    &r->op[LZFSE_KBENCH_DECODE]) != size ||
+		    memcmp(ctx->dec, ctx->src, size) != 0) {
+			pr_err("lzfse_bench: cpu %d size %zu: round trip failed\n",
+			       ctx->cpu, size);
+			return -EIO;
+		}
+	}
+	return 0;
+}
+
+static int lzfse_kbench_run(void) {
+	struct lzfse_kbench_ctx ctx = { 0 };
+	size_t max_size = 0;
+	size_t scratch_size;
+	long ret = 0;
+	int cpu, j;
+
+	mutex_lock(&lzfse_kbench_lock);
+	// The sizes param can be rewritten through sysfs at any time: snapshot
+	// it once and only use the copy, which the buffers are sized for
+	kernel_param_lock(THIS_MODULE);
+	ctx.n_sizes = min_t(int, n_sizes, LZFSE_KBENCH_MAX_SIZES);
+	memcpy(ctx.sizes, sizes, sizeof(ctx.sizes));
+	kernel_param_unlock(THIS_MODULE);
+	for (j = 0; j < ctx.n_sizes; j++) {
+		if (ctx.sizes[j] == 0 || ctx.sizes[j] > LZFSE_KBENCH_MAX_SIZE) {
+			ret = -EINVAL;
+			goto out;
+		}
+		max_size = max_t(size_t, max_size, ctx.sizes[j]);
+	}
+
+	scratch_size = max(lzfse_encode_scratch_size(),
+			   lzfse_decode_scratch_size());
+	ctx.enc_capacity = max_size + max_size / 8 + 4096;
+	ctx.src = vmalloc(max_size);
+	ctx.enc = vmalloc(ctx.enc_capacity);
+	ctx.dec = vmalloc(max_size);
+	ctx.scratch = vmalloc(scratch_size);
+	if (!ctx.src || !ctx.enc || !ctx.dec || !ctx.scratch) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	lzfse_kbench_fill(ctx.src, max_size);
+
+	memset(lzfse_kbench_results, 0,
+	       nr_cpu_ids * LZFSE_KBENCH_MAX_SIZES *
+		       sizeof(*lzfse_kbench_results));
+	lzfse_kbench_n_sizes = ctx.n_sizes;
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		ctx.cpu = cpu;
+		ret = work_on_cpu(cpu, lzfse_kbench_cpu, &ctx);
+		if (ret)
+			break;
+	}
+	cpus_read_unlock();
+	lzfse_kbench_runs++;
+
+out:
+	vfree(ctx.scratch);
+	vfree(ctx.dec);
+	vfree(ctx.enc);
+	vfree(ctx.src);
+	mutex_unlock(&lzfse_kbench_lock);
+	if (ret)
+		pr_err("lzfse_bench: run failed: %ld\n", ret);
+	return (int)ret;
+}
+
+// MARK: - debugfs
+
+static int lzfse_kbench_show(struct seq_file *m, void *v) {
+	int cpu, j, op, b;
+
+	mutex_lock(&lzfse_kbench_lock);
+	seq_printf(m, "runs %llu data %s iterations %u alloc_per_call %d\n",
+		   lzfse_kbench_runs, data, iterations, alloc_per_call);
+	seq_puts(m, "cpu size op calls MB/s avg_ns min_ns max_ns ratio\n");
+	for_each_possible_cpu(cpu) {
+		for (j = 0; j < lzfse_kbench_n_sizes; j++) {
+			const struct lzfse_kbench_result *r =
+				&lzfse_kbench_results[cpu * LZFSE_KBENCH_MAX_SIZES + j];
+			u64 ratio;
+
+			if (r->op[LZFSE_KBENCH_ENCODE].calls == 0)
+				continue;
+			ratio = r->compressed_size
+					? div64_u64((u64)r->size * 1000,
+						    r->compressed_size)
+					: 0;
+			for (op = 0; op < 2; op++) {
+				const struct lzfse_kbench_stat *s = &r->op[op];
+
+				if (s->calls == 0)
+					continue;
+				seq_printf(m, "%d %u %s %llu %llu %llu %llu %llu %llu.%03llu\n",
+					   cpu, r->size, lzfse_kbench_ops[op],
+					   s->calls,
+					   s->ns ? div64_u64(s->bytes * 1000, s->ns) : 0,
+					   div64_u64(s->ns, s->calls), s->min_ns,
+					   s->max_ns, ratio / 1000, ratio % 1000);
+				// Latency histogram, bucket b counts calls in
+				// [2^b, 2^(b+1)) ns
+				seq_puts(m, "  hist");
+				for (b = 0; b < LZFSE_KBENCH_HIST_BUCKETS; b++)
+					if (s->hist[b])
+						seq_printf(m, " 2^%d:%u", b,
+							   s->hist[b]);
+				seq_putc(m, '\n');
+			}
+		}
+	}
+	mutex_unlock(&lzfse_kbench_lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lzfse_kbench);
+
+static ssize_t lzfse_kbench_trigger_write(struct file *file,
+					  const char __user *buf, size_t count,
+					  loff_t *ppos) {
+	bool run;
+	int ret = kstrtobool_from_user(buf, count, &run);
+
+	if (ret)
+		return ret;
+	if (run) {
+		ret = lzfse_kbench_run();
+		if (ret)
+			return ret;
+	}
+	return count;
+}
+
+static const struct file_operations lzfse_kbench_trigger_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = lzfse_kbench_trigger_write,
+	.llseek = noop_llseek,
+};
+
+static int __init lzfse_kbench_init(void) {
+	lzfse_kbench_results =
+		kcalloc(nr_cpu_ids * LZFSE_KBENCH_MAX_SIZES,
+			sizeof(*lzfse_kbench_results), GFP_KERNEL);
+	if (lzfse_kbench_results == NULL)
+		return -ENOMEM;
+
+	lzfse_kbench_dir = debugfs_create_dir("lzfse_bench", NULL);
+	debugfs_create_file("results", 0444, lzfse_kbench_dir, NULL,
+			    &lzfse_kbench_fops);
+	debugfs_create_file("trigger", 0200, lzfse_kbench_dir, NULL,
+			    &lzfse_kbench_trigger_fops);
+
+	// A failed run is logged and leaves the module loaded, so that it can
+	// be triggered again with other parameters
+	if (run_on_load)
+		lzfse_kbench_run();
+	return 0;
+}
+
+static void __exit lzfse_kbench_exit(void) {
+	debugfs_remove_recursive(lzfse_kbench_dir);
+	kfree(lzfse_kbench_results);
+}
+
+module_init(lzfse_kbench_init);
+module_exit(lzfse_kbench_exit);
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("Lzfse Benchmark");
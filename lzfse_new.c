@@ -21,12 +21,17 @@
 
 
 #include "lzfse.h"
+#include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
-
-#include <linux/string.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 
 
 void usage(int argc, char **argv) {
@@ -49,22 +54,296 @@ void usage(int argc, char **argv) {
 	} while (0)
 
 
+#ifndef PAGE_SIZE
 #define PAGE_SIZE 4096
+#endif
+
+// Streaming buffers. The window keeps HISTORY_SIZE bytes of previous data
+// when it slides, which covers every distance the encoder can emit.
+#define WINDOW_SIZE (4 << 20)
+#define HISTORY_SIZE (512 << 10)
+#define IO_SIZE (1 << 20)
 
 enum { LZFSE_ENCODE = 0, LZFSE_DECODE };
 
+// Input source: a mapped file, or a file descriptor read in large blocks.
+typedef struct {
+	int fd;
+	const uint8_t *map;
+	size_t size; // mapped size
+	size_t pos;  // bytes consumed from the map
+} input;
+
+static void *alloc_aligned(size_t size) {
+	void *p = NULL;
+
+	if (posix_memalign(&p, PAGE_SIZE, size ? size : 1) != 0) {
+		fprintf(stderr, "Error: cannot allocate %zu bytes\n", size);
+		exit(1);
+	}
+	return p;
+}
+
+static double now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+// Read up to N bytes from IN to DST. Return the number of bytes read, which
+// is less than N only at the end of the input.
+static size_t read_input(input *in, uint8_t *dst, size_t n) {
+	size_t done = 0;
+
+	if (in->map) {
+		if (n > in->size - in->pos)
+			n = in->size - in->pos;
+		memcpy(dst, in->map + in->pos, n);
+		in->pos += n;
+		return n;
+	}
+	while (done < n) {
+		ssize_t r = read(in->fd, dst + done, n - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0) {
+			perror("read");
+			exit(1);
+		}
+		if (r == 0)
+			break;
+		done += r;
+	}
+	return done;
+}
+
+static void write_output(int fd, const uint8_t *src, size_t n) {
+	while (n > 0) {
+		ssize_t w = write(fd, src, n);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w < 0) {
+			perror("write");
+			exit(1);
+		}
+		src += w;
+		n -= w;
+	}
+}
+
+// Encode IN to OUT_FD one window at a time with the streaming encoder API.
+// Return the number of bytes read and store the bytes written in *OUT_SIZE.
+static size_t stream_encode(input *in, int out_fd, size_t *out_size) {
+	lzfse_encoder_state *s = malloc(lzfse_encode_scratch_size());
+	uint8_t *window = alloc_aligned(WINDOW_SIZE);
+	uint8_t *out = alloc_aligned(2 * WINDOW_SIZE);
+	size_t filled = 0, in_size = 0;
+
+	*out_size = 0;
+	if (s == NULL) {
+		fprintf(stderr, "Error: cannot allocate encoder state\n");
+		exit(1);
+	}
+	memset(s, 0x00, sizeof(*s));
+	if (lzfse_encode_init(s) != LZFSE_STATUS_OK)
+		goto fail;
+	s->src = window;
+	s->dst = s->dst_begin = out;
+	s->dst_end = out + 2 * WINDOW_SIZE;
+
+	for (;;) {
+		size_t n;
+
+		// Slide the window, keeping the history the encoder can still
+		// reference
+		if (filled == WINDOW_SIZE) {
+			const size_t delta = filled - HISTORY_SIZE;
+			lzfse_encode_translate(s, (lzfse_offset)delta);
+			memmove(window, window + delta, HISTORY_SIZE);
+			s->src = window;
+			filled = HISTORY_SIZE;
+		}
+		n = read_input(in, window + filled, WINDOW_SIZE - filled);
+		if (n == 0)
+			break;
+		filled += n;
+		in_size += n;
+
+		// Input smaller than the window: encode it in one call, which
+		// picks LZVN for small inputs and has an uncompressed fallback
+		if (in_size < WINDOW_SIZE) {
+			*out_size = lzfse_encode_buffer(out, 2 * WINDOW_SIZE,
+							window, in_size, s);
+			if (*out_size == 0)
+				goto fail;
+			write_output(out_fd, out, *out_size);
+			goto done;
+		}
+
+		// Keep room for the blocks emitted from one window of input
+		if ((size_t)(s->dst_end - s->dst) < WINDOW_SIZE) {
+			write_output(out_fd, out, s->dst - out);
+			*out_size += s->dst - out;
+			s->dst = out;
+		}
+		s->src_end = (lzfse_offset)filled;
+		if (lzfse_encode_base(s) != LZFSE_STATUS_OK)
+			goto fail;
+	}
+	if (lzfse_encode_finish(s) != LZFSE_STATUS_OK)
+		goto fail;
+	write_output(out_fd, out, s->dst - out);
+	*out_size += s->dst - out;
+
+done:
+	free(out);
+	free(window);
+	free(s);
+	return in_size;
+
+fail:
+	fprintf(stderr, "Error: encode failed\n");
+	exit(1);
+}
+
+// Decode IN to OUT_FD with the streaming decoder API, feeding it input as it
+// is read and writing the decoded window each time it fills up. Return the
+// number of bytes read and store the bytes written in *OUT_SIZE.
+static size_t stream_decode(input *in, int out_fd, size_t *out_size) {
+	lzfse_decoder_state *s = malloc(lzfse_decode_scratch_size());
+	uint8_t *window = alloc_aligned(WINDOW_SIZE);
+	size_t src_allocated = IO_SIZE;
+	uint8_t *src = alloc_aligned(src_allocated);
+	uint8_t *flushed = window;
+	size_t in_size = 0;
+	int eof = 0;
+
+	*out_size = 0;
+	if (s == NULL) {
+		fprintf(stderr, "Error: cannot allocate decoder state\n");
+		exit(1);
+	}
+	memset(s, 0x00, sizeof(*s));
+	s->src = s->src_begin = s->src_end = src;
+	s->dst = s->dst_begin = window;
+	s->dst_end = window + WINDOW_SIZE;
+
+	for (;;) {
+		int status = lzfse_decode(s);
+
+		if (status == LZFSE_STATUS_ERROR)
+			goto fail;
+		if (status == LZFSE_STATUS_OK) {
+			write_output(out_fd, flushed, s->dst - flushed);
+			*out_size += s->dst - flushed;
+			break;
+		}
+		if (status == LZFSE_STATUS_DST_FULL) {
+			// Write the window, and keep its end as history
+			write_output(out_fd, flushed, s->dst - flushed);
+			*out_size += s->dst - flushed;
+			memmove(window, s->dst - HISTORY_SIZE, HISTORY_SIZE);
+			s->dst = flushed = window + HISTORY_SIZE;
+			continue;
+		}
+
+		// SRC_EMPTY: move the unused input to the start of the buffer,
+		// growing it if a whole block does not fit, and read more. The
+		// decoder state only refers to the input through s->src.
+		if (eof)
+			goto fail; // truncated
+		{
+			size_t used = s->src_end - s->src;
+			size_t n;
+
+			if (used == src_allocated) {
+				uint8_t *grown = alloc_aligned(2 * src_allocated);
+				memcpy(grown, s->src, used);
+				free(src);
+				src = grown;
+				src_allocated *= 2;
+			} else {
+				memmove(src, s->src, used);
+			}
+			n = read_input(in, src + used, src_allocated - used);
+			eof = n < src_allocated - used;
+			in_size += n;
+			s->src = s->src_begin = src;
+			s->src_end = src + used + n;
+		}
+	}
+
+	free(src);
+	free(window);
+	free(s);
+	return in_size;
+
+fail:
+	fprintf(stderr, "Error: decode failed\n");
+	exit(1);
+}
+
+// Encode or decode a mapped input in one call. Return 0 on success, and -1
+// if the output size is unknown or the output does not fit, in which case
+// nothing was written.
+static int buffer_op(int op, input *in, int out_fd, size_t *out_size) {
+	size_t out_allocated;
+	uint8_t *out;
+	void *scratch;
+
+	if (op == LZFSE_ENCODE) {
+		// Enough for the uncompressed fallback
+		out_allocated = in->size + PAGE_SIZE;
+		scratch = malloc(lzfse_encode_scratch_size());
+	} else {
+		out_allocated = lzfse_decoded_size(in->map, in->size);
+		if (out_allocated == 0)
+			return -1; // empty or invalid, left to the stream decoder
+		scratch = malloc(lzfse_decode_scratch_size());
+	}
+	if (scratch == NULL)
+		return -1;
+	out = alloc_aligned(out_allocated);
+
+	if (op == LZFSE_ENCODE)
+		*out_size = lzfse_encode_buffer(out, out_allocated, in->map,
+						in->size, scratch);
+	else
+		*out_size = lzfse_decode_buffer(out, out_allocated, in->map,
+						in->size, scratch);
+	if (*out_size == 0 ||
+	    (op == LZFSE_DECODE && *out_size != out_allocated)) {
+		free(out);
+		free(scratch);
+		return -1;
+	}
+	write_output(out_fd, out, *out_size);
+
+	free(out);
+	free(scratch);
+	return 0;
+}
+
 int
 main(int argc, char **argv)
 {
 	const char *in_file = 0;  // stdin
 	const char *out_file = 0; // stdout
 	int op = -1;              // invalid op
+	int verbose = 0;
 	int i;
 	// Parse options
 	for (i = 1; i < argc;) {
 		// no args
 		const char *a = argv[i++];
 
+		if (strcmp(a, "-h") == 0)
+			USAGE(argc, argv);
+		if (strcmp(a, "-v") == 0) {
+			verbose++;
+			continue;
+		}
 		if (strcmp(a, "-encode") == 0) {
 			op = LZFSE_ENCODE;
 			continue;
@@ -83,7 +362,7 @@ main(int argc, char **argv)
 		if (arg_var != 0) {
 			// Flag is recognized. Check if there is an argument.
 			if (i == argc)
-				fprintf(stderr, "Error: Missing arg after %s\n", a);
+				USAGE_MSG(argc, argv, "Error: Missing arg after %s\n", a);
 			*arg_var = argv[i++];
 			continue;
 		}
@@ -93,33 +372,74 @@ main(int argc, char **argv)
 	if (op < 0)
 		USAGE_MSG(argc, argv, "Error: -encode|-decode required\n");
 
-	// Load input
-	size_t file_size = 0; // allocated in IN
-	size_t in_size = PAGE_SIZE;      // used in IN
-	void *in_buff = NULL;         // input buffer
-	int in_fd = -1;          // input file desc
-	size_t file_size;
-
+	// Open input. Regular files are mapped, anything else is streamed.
+	input in = { .fd = 0 };
 	if (in_file != 0) {
-		// If we have a file name, open it, and allocate the exact input size
 		struct stat st;
-		in_fd = open(in_file, O_RDONLY);
-		if (in_fd < 0) {
+		in.fd = open(in_file, O_RDONLY);
+		if (in.fd < 0) {
 			perror(in_file);
 			exit(1);
 		}
-		if (fstat(in_fd, &st) != 0) {
+		if (fstat(in.fd, &st) != 0) {
 			perror(in_file);
 			exit(1);
 		}
-		if (st.st_size > SIZE_MAX) {
+		if ((uint64_t)st.st_size > SIZE_MAX) {
 			fprintf(stderr, "File is too large\n");
 			exit(1);
 		}
-		file_size = PAGE_SIZE;
-	} else {
-		in_fd = 0;
+		if (S_ISREG(st.st_mode) && st.st_size > 0) {
+			void *map = mmap(NULL, st.st_size, PROT_READ,
+					 MAP_PRIVATE, in.fd, 0);
+			if (map != MAP_FAILED) {
+				madvise(map, st.st_size, MADV_SEQUENTIAL);
+				in.map = map;
+				in.size = st.st_size;
+			}
+		}
 	}
 
-	size_t out_allocated = (op == LZFSE_ENCODE) ? PAGE_SIZE : (4 * PAGE_SIZE);
+	// Open output
+	int out_fd = 1; // stdout
+	if (out_file != 0) {
+		out_fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (out_fd < 0) {
+			perror(out_file);
+			exit(1);
+		}
+	}
+
+	// Process
+	size_t in_size = 0, out_size = 0;
+	double t = now();
+	if (in.map && buffer_op(op, &in, out_fd, &out_size) == 0)
+		in_size = in.size;
+	else if (op == LZFSE_ENCODE)
+		in_size = stream_encode(&in, out_fd, &out_size);
+	else
+		in_size = stream_decode(&in, out_fd, &out_size);
+	t = now() - t;
+
+	if (out_file != 0 && close(out_fd) != 0) {
+		perror(out_file);
+		exit(1);
+	}
+	if (in.map)
+		munmap((void *)in.map, in.size);
+	if (in_file != 0)
+		close(in.fd);
+
+	if (verbose) {
+		size_t raw_size = (op == LZFSE_ENCODE) ? in_size : out_size;
+		size_t compressed_size = (op == LZFSE_ENCODE) ? out_size : in_size;
+
+		fprintf(stderr, "LZFSE %s %zu bytes -> %zu bytes\n",
+			(op == LZFSE_ENCODE) ? "encode" : "decode", in_size,
+			out_size);
+		fprintf(stderr, "  ratio %.3f, %.3f s, %.2f MB/s\n",
+			compressed_size ? (double)raw_size / compressed_size : 0.0,
+			t, t > 0 ? raw_size / t * 1e-6 : 0.0);
+	}
+	return 0;
 }
@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:  
+
+1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+    in the documentation and/or other materials provided with the distribution.
+
+3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// LZFSE single page API
+
+#ifdef __KERNEL__
+#include <linux/module.h>
+#endif
+
+#include "lzfse.h"
+#include "lzfse_internal.h"
+
+size_t lzfse_page_scratch_size() { return LZVN_PAGE_WORK_SIZE; }
+
+/*! @abstract Return 1 if all LZVN_PAGE_SIZE bytes of \p page are equal to
+ *  \p page[0]. Most other pages are rejected in the first few words. */
+static inline int lzfse_page_is_filled(const uint8_t *page) {
+  const uint64_t v = (uint64_t)page[0] * 0x0101010101010101ULL;
+  size_t i;
+
+  for (i = 0; i < LZVN_PAGE_SIZE; i += 32) {
+    if ((load8(page + i) ^ v) | (load8(page + i + 8) ^ v) |
+        (load8(page + i + 16) ^ v) | (load8(page + i + 24) ^ v))
+      return 0;
+  }
+  return 1;
+}
+
+/*! @abstract Store the LZVN stream for a page filled with byte \p c at \p dst:
+ *  one literal, then matches at distance 1.
+ *  @return the size of the stream, or 0 if it does not fit in \p dst_size. */
+static size_t lzfse_page_encode_fill(uint8_t *dst, size_t dst_size,
+                                     uint8_t c) {
+  //  sml_d with L = 1, M = 8, D = 1 (the largest M with one literal, larger
+  //  values are undefined opcodes), then as many lrg_m/sml_m opcodes as
+  //  needed for the rest of the page, then end-of-stream.
+  const size_t first_m = 8;
+  size_t n_lrg = (LZVN_PAGE_SIZE - 1 - first_m) / 271;
+  size_t rem = (LZVN_PAGE_SIZE - 1 - first_m) - 271 * n_lrg;
+  size_t size = 3 + 2 * n_lrg + (rem >= 16 ? 2 : rem ? 1 : 0) + 8;
+  uint8_t *q = dst;
+  size_t i;
+
+  if (size > dst_size)
+    return 0;
+  *q++ = (uint8_t)(1 << 6 | (first_m - 3) << 3);
+  *q++ = 1;
+  *q++ = c;
+  for (i = 0; i < n_lrg; i++) {
+    *q++ = 0xf0;
+    *q++ = 271 - 16;
+  }
+  if (rem >= 16) {
+    *q++ = 0xf0;
+    *q++ = (uint8_t)(rem - 16);
+  } else if (rem) {
+    *q++ = (uint8_t)(0xf0 + rem);
+  }
+  store8(q, 0x06); // end-of-stream
+  q += 8;
+  return q - dst;
+}
+
+size_t lzfse_compress_page(uint8_t *dst_buffer, size_t dst_size,
+                           const uint8_t *page, void *scratch_buffer) {
+  //  LZVN block header before the payload, end-of-stream magic after it
+  const size_t extra_size = sizeof(lzvn_compressed_block_header) + 4;
+  lzvn_compressed_block_header header;
+  size_t sz = 0;
+
+  if (dst_size > extra_size) {
+    uint8_t *payload = dst_buffer + sizeof(lzvn_compressed_block_header);
+    if (lzfse_page_is_filled(page))
+      sz = lzfse_page_encode_fill(payload, dst_size - extra_size, page[0]);
+    else
+      sz = lzvn_encode_page(payload, dst_size - extra_size, page,
+                            scratch_buffer);
+  }
+
+  if (sz == 0 || sz >= LZVN_PAGE_SIZE) {
+    //  Does not compress, or not within DST_SIZE: store the page as an
+    //  uncompressed block if it fits.
+    uncompressed_block_header raw = {.magic = LZFSE_UNCOMPRESSED_BLOCK_MAGIC,
+                                     .n_raw_bytes = (uint32_t)LZVN_PAGE_SIZE};
+    if (sizeof raw + LZVN_PAGE_SIZE + 4 > dst_size)
+      return 0;
+    memcpy(dst_buffer, &raw, sizeof raw);
+    memcpy(dst_buffer + sizeof raw, page, LZVN_PAGE_SIZE);
+    store4(dst_buffer + sizeof raw + LZVN_PAGE_SIZE,
+           LZFSE_ENDOFSTREAM_BLOCK_MAGIC);
+    return sizeof raw + LZVN_PAGE_SIZE + 4;
+  }
+
+  header.magic = LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC;
+  header.n_raw_bytes = (uint32_t)LZVN_PAGE_SIZE;
+  header.n_payload_bytes = (uint32_t)sz;
+  memcpy(dst_buffer, &header, sizeof(header));
+  store4(dst_buffer + sizeof(header) + sz, LZFSE_ENDOFSTREAM_BLOCK_MAGIC);
+  return sz + extra_size;
+}
+
+int lzfse_decompress_page(uint8_t *page, const uint8_t *src_buffer,
+                          size_t src_size) {
+  lzvn_compressed_block_header header;
+  lzvn_decoder_state dstate;
+
+  if (src_size < sizeof(uncompressed_block_header) + 4)
+    return -1;
+  memcpy(&header, src_buffer, sizeof(uint32_t) * 2); // magic, n_raw_bytes
+  if (header.n_raw_bytes != LZVN_PAGE_SIZE)
+    return -1;
+
+  if (header.magic == LZFSE_UNCOMPRESSED_BLOCK_MAGIC) {
+    const uint8_t *raw = src_buffer + sizeof(uncompressed_block_header);
+    if (src_size != sizeof(uncompressed_block_header) + LZVN_PAGE_SIZE + 4 ||
+        load4(raw + LZVN_PAGE_SIZE) != LZFSE_ENDOFSTREAM_BLOCK_MAGIC)
+      return -1;
+    memcpy(page, raw, LZVN_PAGE_SIZE);
+    return 0;
+  }
+
+  if (header.magic != LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC ||
+      src_size < sizeof(header) + 4)
+    return -1;
+  memcpy(&header, src_buffer, sizeof(header));
+  if (header.n_payload_bytes != src_size - sizeof(header) - 4 ||
+      load4(src_buffer + src_size - 4) != LZFSE_ENDOFSTREAM_BLOCK_MAGIC)
+    return -1;
+
+  memset(&dstate, 0, sizeof(dstate));
+  dstate.src = src_buffer + sizeof(header);
+  dstate.src_end = dstate.src + header.n_payload_bytes;
+  dstate.dst_begin = page;
+  dstate.dst = page;
+  dstate.dst_end = page + LZVN_PAGE_SIZE;
+  lzvn_decode(&dstate);
+  if (!dstate.end_of_stream || dstate.dst != dstate.dst_end ||
+      dstate.src != dstate.src_end)
+    return -1;
+  return 0;
+}
+
+EXPORT_SYMBOL(lzfse_page_scratch_size);
+EXPORT_SYMBOL(lzfse_compress_page);
+EXPORT_SYMBOL(lzfse_decompress_page);
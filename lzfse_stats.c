@@ -0,0 +1,149 @@
+/*
+Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:  
+
+1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+    in the documentation and/or other materials provided with the distribution.
+
+3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// LZFSE usage statistics, exported in /sys/kernel/debug/lzfse
+
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "lzfse.h"
+#include "lzfse_internal.h"
+
+DEFINE_PER_CPU(lzfse_stats, lzfse_stats_pcpu);
+
+static struct dentry *lzfse_debugfs_dir;
+
+static const char *const lzfse_stats_block_names[LZFSE_STAT_BLOCK_TYPES] = {
+    "uncompressed", "lzvn", "v1", "v2", "end_of_stream"};
+
+//  Number of counters in lzfse_stats, which only holds uint64_t fields
+#define LZFSE_STATS_N (sizeof(lzfse_stats) / sizeof(uint64_t))
+
+//  Sum the counters of all CPUs to SUM. The counters of other CPUs may change
+//  while they are read, which only makes the sum slightly stale.
+static void lzfse_stats_sum(lzfse_stats *sum) {
+  uint64_t *total = (uint64_t *)sum;
+  int cpu;
+  size_t i;
+
+  memset(sum, 0x00, sizeof(*sum));
+  for_each_possible_cpu(cpu) {
+    const uint64_t *c = (const uint64_t *)per_cpu_ptr(&lzfse_stats_pcpu, cpu);
+    for (i = 0; i < LZFSE_STATS_N; i++)
+      total[i] += c[i];
+  }
+}
+
+#define LZFSE_STATS_SHOW(m, s, field)                                          \
+  seq_printf(m, "%s %llu\n", #field, (unsigned long long)(s)->field)
+
+static int lzfse_stats_show(struct seq_file *m, void *v) {
+  lzfse_stats s;
+  int i;
+
+  lzfse_stats_sum(&s);
+  LZFSE_STATS_SHOW(m, &s, encode_calls);
+  LZFSE_STATS_SHOW(m, &s, encode_bytes_in);
+  LZFSE_STATS_SHOW(m, &s, encode_bytes_out);
+  LZFSE_STATS_SHOW(m, &s, encode_ns);
+  LZFSE_STATS_SHOW(m, &s, encode_lzvn);
+  LZFSE_STATS_SHOW(m, &s, encode_chunked);
+  LZFSE_STATS_SHOW(m, &s, encode_uncompressed);
+  LZFSE_STATS_SHOW(m, &s, encode_failed);
+  for (i = 0; i < LZFSE_STAT_BLOCK_TYPES; i++)
+    seq_printf(m, "encode_blocks_%s %llu\n", lzfse_stats_block_names[i],
+               (unsigned long long)s.encode_blocks[i]);
+  LZFSE_STATS_SHOW(m, &s, decode_calls);
+  LZFSE_STATS_SHOW(m, &s, decode_bytes_in);
+  LZFSE_STATS_SHOW(m, &s, decode_bytes_out);
+  LZFSE_STATS_SHOW(m, &s, decode_ns);
+  LZFSE_STATS_SHOW(m, &s, decode_dst_full);
+  LZFSE_STATS_SHOW(m, &s, decode_errors);
+  for (i = 0; i < LZFSE_STAT_BLOCK_TYPES; i++)
+    seq_printf(m, "decode_blocks_%s %llu\n", lzfse_stats_block_names[i],
+               (unsigned long long)s.decode_blocks[i]);
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lzfse_stats);
+
+#if LZFSE_INSTRUMENT
+//  Cycles spent in each encoder stage, as a count and a share of the time
+//  spent in all stages. Time outside of the stages is not charged, so
+//  LZFSE_STAGE_OTHER is left out.
+static int lzfse_stages_show(struct seq_file *m, void *v) {
+  uint64_t cycles[LZFSE_STAGES];
+  uint64_t total = 0;
+  int i;
+
+  lzfse_instrument_read(cycles);
+  for (i = LZFSE_STAGE_OTHER + 1; i < LZFSE_STAGES; i++)
+    total += cycles[i];
+  for (i = LZFSE_STAGE_OTHER + 1; i < LZFSE_STAGES; i++)
+    seq_printf(m, "%-12s %16llu %3llu%%\n", lzfse_instrument_stage_name(i),
+               (unsigned long long)cycles[i],
+               total ? (unsigned long long)div64_u64(100 * cycles[i], total)
+                     : 0ULL);
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lzfse_stages);
+#endif
+
+//  Writing anything to the reset file clears all counters. Updates running
+//  concurrently on other CPUs may survive the reset.
+static ssize_t lzfse_stats_reset_write(struct file *file,
+                                       const char __user *buf, size_t count,
+                                       loff_t *ppos) {
+  int cpu;
+
+  for_each_possible_cpu(cpu)
+    memset(per_cpu_ptr(&lzfse_stats_pcpu, cpu), 0x00, sizeof(lzfse_stats));
+  lzfse_instrument_reset();
+  return count;
+}
+
+static const struct file_operations lzfse_stats_reset_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .write = lzfse_stats_reset_write,
+    .llseek = noop_llseek,
+};
+
+static int __init lzfse_stats_init(void) {
+  lzfse_debugfs_dir = debugfs_create_dir("lzfse", NULL);
+  debugfs_create_file("stats", 0444, lzfse_debugfs_dir, NULL,
+                      &lzfse_stats_fops);
+  debugfs_create_file("reset", 0200, lzfse_debugfs_dir, NULL,
+                      &lzfse_stats_reset_fops);
+#if LZFSE_INSTRUMENT
+  debugfs_create_file("stages", 0444, lzfse_debugfs_dir, NULL,
+                      &lzfse_stages_fops);
+#endif
+  return 0;
+}
+
+static void __exit lzfse_stats_exit(void) {
+  debugfs_remove_recursive(lzfse_debugfs_dir);
+}
+
+module_init(lzfse_stats_init);
+module_exit(lzfse_stats_exit);
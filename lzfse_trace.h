@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2015-2016, Apple Inc. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1.  Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2.  Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+    in the documentation and/or other materials provided with the distribution.
+
+3.  Neither the name of the copyright holder(s) nor the names of any contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// LZFSE tracepoints, in the lzfse trace system. Userspace builds compile the
+// trace_* calls away.
+
+#ifdef __KERNEL__
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lzfse
+
+#if !defined(LZFSE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LZFSE_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#define LZFSE_TRACE_SHOW_MAGIC(magic)                                          \
+  __print_symbolic(magic, {LZFSE_UNCOMPRESSED_BLOCK_MAGIC, "bvx-"},            \
+                   {LZFSE_COMPRESSEDV1_BLOCK_MAGIC, "bvx1"},                   \
+                   {LZFSE_COMPRESSEDV2_BLOCK_MAGIC, "bvx2"},                   \
+                   {LZFSE_COMPRESSEDLZVN_BLOCK_MAGIC, "bvxn"},                 \
+                   {LZFSE_ENDOFSTREAM_BLOCK_MAGIC, "bvx$"})
+
+#define LZFSE_TRACE_SHOW_PATH(path)                                            \
+  __print_symbolic(path, {LZFSE_TRACE_PATH_LZVN, "lzvn"},                      \
+                   {LZFSE_TRACE_PATH_CHUNKED, "chunked"},                      \
+                   {LZFSE_TRACE_PATH_UNCOMPRESSED, "uncompressed"},            \
+                   {LZFSE_TRACE_PATH_FAILED, "failed"})
+
+//  Export the path values so that user space tools can resolve the symbolic
+//  names in the event formats.
+TRACE_DEFINE_ENUM(LZFSE_TRACE_PATH_LZVN);
+TRACE_DEFINE_ENUM(LZFSE_TRACE_PATH_CHUNKED);
+TRACE_DEFINE_ENUM(LZFSE_TRACE_PATH_UNCOMPRESSED);
+TRACE_DEFINE_ENUM(LZFSE_TRACE_PATH_FAILED);
+
+DECLARE_EVENT_CLASS(lzfse_buffer_enter,
+  TP_PROTO(size_t src_size, size_t dst_size),
+  TP_ARGS(src_size, dst_size),
+  TP_STRUCT__entry(
+    __field(size_t, src_size)
+    __field(size_t, dst_size)
+  ),
+  TP_fast_assign(
+    __entry->src_size = src_size;
+    __entry->dst_size = dst_size;
+  ),
+  TP_printk("src_size=%zu dst_size=%zu", __entry->src_size,
+            __entry->dst_size)
+);
+
+/*! @abstract lzfse_encode_buffer entry. */
+DEFINE_EVENT(lzfse_buffer_enter, lzfse_encode_enter,
+  TP_PROTO(size_t src_size, size_t dst_size),
+  TP_ARGS(src_size, dst_size)
+);
+
+/*! @abstract lzfse_decode_buffer (and variants) entry. */
+DEFINE_EVENT(lzfse_buffer_enter, lzfse_decode_enter,
+  TP_PROTO(size_t src_size, size_t dst_size),
+  TP_ARGS(src_size, dst_size)
+);
+
+/*! @abstract lzfse_encode_buffer exit, \p ret is 0 on failure. */
+TRACE_EVENT(lzfse_encode_exit,
+  TP_PROTO(size_t src_size, size_t ret),
+  TP_ARGS(src_size, ret),
+  TP_STRUCT__entry(
+    __field(size_t, src_size)
+    __field(size_t, ret)
+  ),
+  TP_fast_assign(
+    __entry->src_size = src_size;
+    __entry->ret = ret;
+  ),
+  TP_printk("src_size=%zu ret=%zu", __entry->src_size, __entry->ret)
+);
+
+/*! @abstract lzfse_decode_buffer (and variants) exit, with the decoder
+ *  status. */
+TRACE_EVENT(lzfse_decode_exit,
+  TP_PROTO(size_t src_size, size_t ret, int status),
+  TP_ARGS(src_size, ret, status),
+  TP_STRUCT__entry(
+    __field(size_t, src_size)
+    __field(size_t, ret)
+    __field(int, status)
+  ),
+  TP_fast_assign(
+    __entry->src_size = src_size;
+    __entry->ret = ret;
+    __entry->status = status;
+  ),
+  TP_printk("src_size=%zu ret=%zu status=%d", __entry->src_size,
+            __entry->ret, __entry->status)
+);
+
+/*! @abstract A block was written by the encoder. \p n_payload_bytes includes
+ *  the block header. bvx2 blocks are traced as they are written: an
+ *  lzfse_encode_fallback event with path uncompressed or failed that follows
+ *  in the same call means they were discarded. */
+TRACE_EVENT(lzfse_encode_block,
+  TP_PROTO(uint32_t magic, uint32_t n_raw_bytes, uint32_t n_payload_bytes),
+  TP_ARGS(magic, n_raw_bytes, n_payload_bytes),
+  TP_STRUCT__entry(
+    __field(uint32_t, magic)
+    __field(uint32_t, n_raw_bytes)
+    __field(uint32_t, n_payload_bytes)
+  ),
+  TP_fast_assign(
+    __entry->magic = magic;
+    __entry->n_raw_bytes = n_raw_bytes;
+    __entry->n_payload_bytes = n_payload_bytes;
+  ),
+  TP_printk("type=%s n_raw_bytes=%u n_payload_bytes=%u",
+            LZFSE_TRACE_SHOW_MAGIC(__entry->magic), __entry->n_raw_bytes,
+            __entry->n_payload_bytes)
+);
+
+/*! @abstract lzfse_encode_buffer left the regular LZFSE path. */
+TRACE_EVENT(lzfse_encode_fallback,
+  TP_PROTO(int path, size_t src_size, size_t dst_size),
+  TP_ARGS(path, src_size, dst_size),
+  TP_STRUCT__entry(
+    __field(int, path)
+    __field(size_t, src_size)
+    __field(size_t, dst_size)
+  ),
+  TP_fast_assign(
+    __entry->path = path;
+    __entry->src_size = src_size;
+    __entry->dst_size = dst_size;
+  ),
+  TP_printk("path=%s src_size=%zu dst_size=%zu",
+            LZFSE_TRACE_SHOW_PATH(__entry->path), __entry->src_size,
+            __entry->dst_size)
+);
+
+#endif // LZFSE_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE lzfse_trace
+#include <trace/define_trace.h>
+
+#else // !__KERNEL__
+
+#ifndef LZFSE_TRACE_H
+#define LZFSE_TRACE_H
+
+#define trace_lzfse_encode_enter(src_size, dst_size) ((void)0)
+#define trace_lzfse_decode_enter(src_size, dst_size) ((void)0)
+#define trace_lzfse_encode_exit(src_size, ret) ((void)0)
+#define trace_lzfse_decode_exit(src_size, ret, status) ((void)0)
+#define trace_lzfse_encode_block(magic, n_raw_bytes, n_payload_bytes) ((void)0)
+#define trace_lzfse_encode_fallback(path, src_size, dst_size) ((void)0)
+
+#endif // LZFSE_TRACE_H
+
+#endif // !__KERNEL__
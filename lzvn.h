@@ -22,8 +22,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #ifndef LZVN_H
 #define LZVN_H
 
-#include <linux/stddef.h>
-#include <linux/types.h>
+#include "lzfse_compat.h"
 
 size_t lzvn_decode_scratch_size(void);
 size_t lzvn_encode_scratch_size(void);
@@ -34,6 +33,13 @@ size_t lzvn_decode_buffer(void *dst, size_t dst_size,
 			  const void *src, size_t src_size,
 			  void *work);
 
+/*! @abstract Same as lzvn_encode_buffer, with the match search effort selected
+ *  by \p level, one of the LZVN_ENCODE_LEVEL_* values. All levels produce
+ *  regular LZVN streams and use the same \p work buffer. */
+size_t lzvn_encode_buffer_level(void *dst, size_t dst_size,
+				const void *src, size_t src_size,
+				void *work, int level);
+
 // MARK: - LZVN encode/decode interfaces
 
 //  Minimum source buffer size for compression. Smaller buffers will not be
@@ -93,6 +99,21 @@ typedef struct {
  *  Updates \p state (src,dst,d_prev). */
 void lzvn_decode(lzvn_decoder_state *state);
 
+/*! @abstract Encode exactly LZVN_PAGE_SIZE bytes from \p src, using
+ *  LZVN_PAGE_WORK_SIZE bytes of \p work. The encoder stops as soon as the
+ *  output would not fit in \p dst_size bytes.
+ *  @return the size of the LZVN stream, or 0 if it does not fit. */
+size_t lzvn_encode_page(void *dst, size_t dst_size, const void *src,
+                        void *work);
+
+/*! @abstract Check that \p src holds a complete LZVN stream, ending with an
+ *  end-of-stream opcode, that decodes to exactly \p dst_size bytes. Matches
+ *  may reference \p history bytes of output preceding the stream. Nothing is
+ *  decoded or written.
+ *  @return 0 if the stream is valid, -1 otherwise. */
+int lzvn_validate(const void *src, size_t src_size, size_t dst_size,
+                  size_t history);
+
 /*! @abstract Decoder state object for lzvn-compressed blocks. */
 typedef struct {
   uint32_t n_raw_bytes;
@@ -122,6 +143,8 @@ typedef struct {
   4 // stored offsets stack for each hash value, MUST be 4
 #define LZVN_ENCODE_HASH_VALUES                                                \
   (1 << LZVN_ENCODE_HASH_BITS) // number of entries in hash table
+#define LZVN_ENCODE_MIN_HASH_BITS                                              \
+  10 // smallest table used for small inputs, see lzvn_encode_hash_bits
 #define LZVN_ENCODE_MAX_DISTANCE                                               \
   0xffff // max match distance we can represent with LZVN encoding, MUST be
          // 0xFFFF
@@ -132,6 +155,18 @@ typedef struct {
   400 // if the number of pending literals exceeds this size, emit a long
       // literal, MUST be >= 271
 
+//  Encoder levels. DEFAULT is the historical encoder: 4 candidates per hash
+//  and a one-step lazy choice between overlapping matches. FAST checks a
+//  single candidate, emits matches right away and skips ahead in
+//  incompressible data. HIGH keeps improving the pending match at the
+//  following positions before emitting it.
+#define LZVN_ENCODE_LEVEL_DEFAULT 0
+#define LZVN_ENCODE_LEVEL_FAST 1
+#define LZVN_ENCODE_LEVEL_HIGH 2
+
+#define LZVN_ENCODE_FAST_SKIP_SHIFT                                            \
+  5 // FAST: after N literals without a match, skip N >> SHIFT positions
+
 /*! @abstract Type of table entry. */
 typedef struct {
   int32_t indices[4]; // signed indices in source buffer
@@ -142,6 +177,15 @@ typedef struct {
 #define LZVN_ENCODE_WORK_SIZE                                                  \
   (LZVN_ENCODE_HASH_VALUES * sizeof(lzvn_encode_entry_type))
 
+// Input size, hash bits and work size of lzvn_encode_page. One bucket per
+// two input bytes, as for other small inputs (2K buckets for 4 KB pages).
+#define LZVN_PAGE_SIZE ((size_t)PAGE_SIZE)
+#define LZVN_PAGE_HASH_BITS                                                    \
+  (PAGE_SHIFT - 1 < LZVN_ENCODE_HASH_BITS ? PAGE_SHIFT - 1                     \
+                                          : LZVN_ENCODE_HASH_BITS)
+#define LZVN_PAGE_WORK_SIZE                                                    \
+  ((1 << LZVN_PAGE_HASH_BITS) * sizeof(lzvn_encode_entry_type))
+
 /*! @abstract Match */
 typedef struct {
   lzvn_offset m_begin; // beginning of match, current position
@@ -190,9 +234,20 @@ typedef struct {
 
   // Hash table used to find matches. Stores LZVN_ENCODE_OFFSETS_PER_HASH 32-bit
   // signed indices in the source buffer, and the corresponding 4-byte values.
-  // The number of entries in the table is LZVN_ENCODE_HASH_VALUES.
+  // The number of entries in the table is 1 << hash_bits.
   lzvn_encode_entry_type *table;
 
+  // Number of hash bits actually used, in [LZVN_ENCODE_MIN_HASH_BITS,
+  // LZVN_ENCODE_HASH_BITS], or 0 for LZVN_ENCODE_HASH_BITS
+  int hash_bits;
+
+  // Match search effort, one of the LZVN_ENCODE_LEVEL_* values
+  int level;
+
+  // Stage being timed and its start, in LZFSE_INSTRUMENT=1 builds
+  int instrument_stage;
+  uint64_t instrument_start;
+
 } lzvn_encoder_state;
 
 /*! @abstract Encode source to destination.
@@ -21,7 +21,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 
 // LZVN low-level decoder
 
-#if __linux__
+#ifdef __KERNEL__
 #include <linux/module.h>
 #endif
 
@@ -43,6 +43,133 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #define UPDATE_GOOD                                                            \
   (state->src = src_ptr, state->dst = dst_ptr, state->d_prev = D)
 
+//  Minimum number of bytes left in both the source and destination buffers
+//  to run lzvn_decode_fast: the largest opcode with its literal (lrg_l, 2 +
+//  271 bytes) or the largest match (lrg_m, 271 bytes), the slop of 32-byte
+//  copies, and the first byte of the next opcode.
+#define LZVN_FAST_MARGIN 320
+
+/*! @abstract Copy a match of length \p M at distance \p D >= 1, with the
+ *  semantics of a byte-by-byte forward copy. Writes up to 31 bytes past
+ *  \p dst + \p M. */
+static inline void lzvn_copy_match(unsigned char *dst, size_t D, size_t M) {
+  const unsigned char *src = dst - D;
+  unsigned char *dst_end = dst + M;
+  size_t i;
+
+  if (D >= 32) {
+    for (i = 0; i < M; i += 32)
+      copy32(&dst[i], &src[i]);
+  } else if (D >= 16) {
+    for (i = 0; i < M; i += 16)
+      copy16(&dst[i], &src[i]);
+  } else if (D >= 8) {
+    for (i = 0; i < M; i += 8)
+      copy8(&dst[i], &src[i]);
+  } else {
+    //  Short distance: expand the first 8 bytes of the repeating pattern one
+    //  word at a time, then move SRC back so that DST - SRC is a multiple of
+    //  D which is >= 8, and continue with 8-byte copies.
+    static const int8_t inc[8] = {0, 1, 2, 1, 0, 4, 4, 4};
+    static const int8_t dec[8] = {0, 0, 0, -1, -4, 1, 2, 3};
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+    dst[3] = src[3];
+    src += inc[D];
+    store4(dst + 4, load4(src));
+    src -= dec[D];
+    for (dst += 8; dst < dst_end; dst += 8, src += 8)
+      copy8(dst, src);
+  }
+}
+
+/*! @abstract Decode opcodes from \p *psrc to \p *pdst as long as both buffers
+ *  have at least LZVN_FAST_MARGIN bytes left, so no opcode needs any bounds
+ *  check. Stops before end-of-stream, nop, undefined opcodes and invalid
+ *  match distances, which are left to the checked path of lzvn_decode. */
+static inline void lzvn_decode_fast(const unsigned char **psrc,
+                                    size_t *psrc_len, unsigned char **pdst,
+                                    size_t *pdst_len, size_t *pD,
+                                    const unsigned char *dst_begin) {
+  const unsigned char *src_ptr = *psrc;
+  unsigned char *dst_ptr = *pdst;
+  size_t src_len = *psrc_len;
+  size_t dst_len = *pdst_len;
+  size_t D = *pD;
+  size_t L, M, opc_len, i;
+
+  while (src_len >= LZVN_FAST_MARGIN && dst_len >= LZVN_FAST_MARGIN) {
+    unsigned char opc = src_ptr[0];
+
+    if (opc >= 224) {
+      if (opc < 240) {
+        // sml_l, lrg_l
+        opc_len = (opc == 224) ? 2 : 1;
+        L = (opc == 224) ? (size_t)src_ptr[1] + 16
+                         : (size_t)extract(opc, 0, 4);
+        PTR_LEN_INC(src_ptr, src_len, opc_len);
+        for (i = 0; i < L; i += 16)
+          copy16(&dst_ptr[i], &src_ptr[i]);
+        PTR_LEN_INC(dst_ptr, dst_len, L);
+        PTR_LEN_INC(src_ptr, src_len, L);
+      } else {
+        // sml_m, lrg_m
+        opc_len = (opc == 240) ? 2 : 1;
+        if (D == 0)
+          break; // no previous distance, let the checked path copy
+        M = (opc == 240) ? (size_t)src_ptr[1] + 16
+                         : (size_t)extract(opc, 0, 4);
+        PTR_LEN_INC(src_ptr, src_len, opc_len);
+        lzvn_copy_match(dst_ptr, D, M);
+        PTR_LEN_INC(dst_ptr, dst_len, M);
+      }
+      continue;
+    }
+
+    // Literal and match
+    size_t new_d = D;
+    if (opc >= 160 && opc < 192) {
+      // med_d
+      opc_len = 3;
+      L = (size_t)extract(opc, 3, 2);
+      uint16_t opc23 = load2(&src_ptr[1]);
+      M = (size_t)((extract(opc, 0, 3) << 2 | extract(opc23, 0, 2)) + 3);
+      new_d = (size_t)extract(opc23, 2, 14);
+    } else if ((opc < 64 && (opc & 7) == 6) || (opc >= 112 && opc < 128) ||
+               (opc >= 208 && opc < 224)) {
+      break; // eos, nop, udef
+    } else {
+      L = (size_t)extract(opc, 6, 2);
+      M = (size_t)extract(opc, 3, 3) + 3;
+      if ((opc & 7) == 6) {
+        opc_len = 1; // pre_d
+      } else if ((opc & 7) == 7) {
+        opc_len = 3; // lrg_d
+        new_d = load2(&src_ptr[1]);
+      } else {
+        opc_len = 2; // sml_d
+        new_d = (size_t)extract(opc, 0, 3) << 8 | src_ptr[1];
+      }
+    }
+    if (new_d > (size_t)(dst_ptr - dst_begin) + L || new_d == 0)
+      break; // invalid match distance
+    D = new_d;
+    PTR_LEN_INC(src_ptr, src_len, opc_len);
+    store4(dst_ptr, load4(src_ptr));
+    PTR_LEN_INC(dst_ptr, dst_len, L);
+    PTR_LEN_INC(src_ptr, src_len, L);
+    lzvn_copy_match(dst_ptr, D, M);
+    PTR_LEN_INC(dst_ptr, dst_len, M);
+  }
+
+  *psrc = src_ptr;
+  *psrc_len = src_len;
+  *pdst = dst_ptr;
+  *pdst_len = dst_len;
+  *pD = D;
+}
+
 void lzvn_decode(lzvn_decoder_state *state) {
 #if HAVE_LABELS_AS_VALUES
   // Jump table for all instructions
@@ -106,6 +233,12 @@ void lzvn_decode(lzvn_decoder_state *state) {
     goto copy_literal_and_match;
   }
 
+  //  Decode the bulk of the stream without bounds checks, then finish with
+  //  the checked opcode implementations below
+  lzvn_decode_fast(&src_ptr, &src_len, &dst_ptr, &dst_len, &D,
+                   state->dst_begin);
+  UPDATE_GOOD;
+
   unsigned char opc = src_ptr[0];
 
 #if HAVE_LABELS_AS_VALUES
@@ -443,7 +576,11 @@ copy_match:
   //
   //  i.e. it splats the previous byte. This means that we need to be very
   //  careful about using wide loads or stores to perform the copy operation.
-  if (__builtin_expect(dst_len >= M + 7 && D >= 8, 1)) {
+  if (__builtin_expect(dst_len >= M + 31 && D != 0, 1)) {
+    //  We are far enough from the end of the buffer for the wide copies of
+    //  lzvn_copy_match, including its pattern expansion for small D.
+    lzvn_copy_match(dst_ptr, D, M);
+  } else if (dst_len >= M + 7 && D >= 8) {
     //  We are not near the end of the buffer, and the match distance
     //  is at least eight. Thus, we can safely loop using eight byte
     //  copies. The last of these may slop over the intended end of
@@ -717,6 +854,89 @@ invalid_match_distance:
 #endif
 }
 
+int lzvn_validate(const void *src_buffer, size_t src_size, size_t dst_size,
+                  size_t history) {
+  const unsigned char *src_ptr = (const unsigned char *)src_buffer;
+  size_t src_len = src_size;
+  size_t out = 0; // bytes that would have been written
+  size_t D = 0;
+  size_t L, M, opc_len;
+
+  //  Same opcode parsing and source checks as lzvn_decode, but only the
+  //  output length and the match distances are tracked.
+  while (src_len > 0) {
+    unsigned char opc = src_ptr[0];
+    L = M = 0;
+
+    if (opc == 6) {
+      // eos
+      if (src_len != 8)
+        return -1; // eos must end the payload
+      return (out == dst_size) ? 0 : -1;
+    }
+    if (opc == 14 || opc == 22) {
+      // nop
+      if (src_len <= 1)
+        return -1; // source truncated
+      PTR_LEN_INC(src_ptr, src_len, 1);
+      continue;
+    }
+    if ((opc < 64 && (opc & 7) == 6) || (opc >= 112 && opc < 128) ||
+        (opc >= 208 && opc < 224))
+      return -1; // udef
+
+    if (opc >= 224) {
+      if (opc < 240) {
+        // sml_l, lrg_l: literal only
+        opc_len = (opc == 224) ? 2 : 1;
+        if (src_len <= opc_len)
+          return -1; // source truncated
+        L = (opc == 224) ? (size_t)src_ptr[1] + 16
+                         : (size_t)extract(opc, 0, 4);
+      } else {
+        // sml_m, lrg_m: match only, previous distance
+        opc_len = (opc == 240) ? 2 : 1;
+        if (src_len <= opc_len)
+          return -1; // source truncated
+        M = (opc == 240) ? (size_t)src_ptr[1] + 16
+                         : (size_t)extract(opc, 0, 4);
+      }
+    } else {
+      // sml_d, med_d, lrg_d, pre_d: literal and match
+      if (opc >= 160 && opc < 192) {
+        opc_len = 3;
+        L = (size_t)extract(opc, 3, 2);
+        if (src_len <= opc_len + L)
+          return -1; // source truncated
+        uint16_t opc23 = load2(&src_ptr[1]);
+        M = (size_t)((extract(opc, 0, 3) << 2 | extract(opc23, 0, 2)) + 3);
+        D = (size_t)extract(opc23, 2, 14);
+      } else {
+        opc_len = ((opc & 7) == 6) ? 1 : ((opc & 7) == 7) ? 3 : 2;
+        L = (size_t)extract(opc, 6, 2);
+        M = (size_t)extract(opc, 3, 3) + 3;
+        if (src_len <= opc_len + L)
+          return -1; // source truncated
+        if ((opc & 7) == 7)
+          D = load2(&src_ptr[1]);
+        else if ((opc & 7) != 6)
+          D = (size_t)extract(opc, 0, 3) << 8 | src_ptr[1];
+      }
+      if (D > history + out + L || D == 0)
+        return -1; // invalid match distance
+    }
+
+    if (src_len <= opc_len + L)
+      return -1; // source truncated
+    PTR_LEN_INC(src_ptr, src_len, opc_len + L);
+    if (L + M > dst_size - out)
+      return -1; // too many output bytes
+    out += L + M;
+  }
+
+  return -1; // no eos
+}
+
 size_t lzvn_decode_buffer(void *dst_buffer,
 			  size_t dst_size, const void *src_buffer,
 			  size_t src_size, void *scratch_buffer)
@@ -743,5 +963,6 @@ size_t lzvn_decode_scratch_size() { return sizeof(lzvn_decoder_state); }
 EXPORT_SYMBOL(lzvn_decode_scratch_size);
 EXPORT_SYMBOL(lzvn_decode_buffer);
 EXPORT_SYMBOL(lzvn_decode);
+EXPORT_SYMBOL(lzvn_validate);
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("Lzvn Decompressor");
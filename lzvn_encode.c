@@ -21,7 +21,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 
 // LZVN low-level encoder
 
-#if __linux__
+#ifdef __KERNEL__
 #include <linux/module.h>
 #endif
 
@@ -197,11 +197,22 @@ static inline lzvn_offset offset_from_s32(int32_t x) { return (lzvn_offset)x; }
 // ===============================================================
 // Hash and Matching
 
-/*! @abstract Get hash in range \c [0,LZVN_ENCODE_HASH_VALUES-1] from 3 bytes in i. */
-static inline uint32_t hash3i(uint32_t i) {
+/*! @abstract Get hash in range \c [0,mask] from 3 bytes in i. */
+static inline uint32_t hash3i(uint32_t i, uint32_t mask) {
   i &= 0xffffff; // truncate to 24-bit input (slightly increases compression ratio)
   uint32_t h = (i * (1 + (1 << 6) + (1 << 12))) >> 12;
-  return h & (LZVN_ENCODE_HASH_VALUES - 1);
+  return h & mask;
+}
+
+/*! @abstract Number of hash bits to use for a \p src_size bytes input.
+ * A table with about one entry per two input bytes keeps nearly all the
+ * candidates of the full table for small inputs, and is much cheaper to
+ * initialize: 64 KB instead of 512 KB for a 4 KB page. */
+static inline int lzvn_encode_hash_bits(size_t src_size) {
+  int bits = LZVN_ENCODE_MIN_HASH_BITS;
+  while (bits < LZVN_ENCODE_HASH_BITS && ((size_t)2 << bits) < src_size)
+    bits++;
+  return bits;
 }
 
 /*! @abstract Return the number [0, 4] of zero bytes in \p x, starting from the
@@ -319,8 +330,10 @@ static inline lzvn_offset lzvn_emit_match(lzvn_encoder_state *state,
   size_t M = (size_t)match.M;                              // match length
   size_t D = (size_t)match.D;                              // match distance
   size_t D_prev = (size_t)state->d_prev; // previously emitted match distance
+  int stage = LZFSE_STAGE_ENTER(state, LZVN_STAGE_EMIT);
   unsigned char *dst = emit(state->src + state->src_literal, state->dst,
                             state->dst_end, L, M, D, D_prev);
+  LZFSE_STAGE_LEAVE(state, stage);
   // Check if DST is full
   if (dst >= state->dst_end) {
     return 0; // FULL
@@ -340,8 +353,10 @@ static inline lzvn_offset lzvn_emit_match(lzvn_encoder_state *state,
 static inline lzvn_offset lzvn_emit_literal(lzvn_encoder_state *state,
                                             lzvn_offset n) {
   size_t L = (size_t)n;
+  int stage = LZFSE_STAGE_ENTER(state, LZVN_STAGE_EMIT);
   unsigned char *dst = emit_literal(state->src + state->src_literal, state->dst,
                                     state->dst_end, L);
+  LZFSE_STAGE_LEAVE(state, stage);
   // Check if DST is full
   if (dst >= state->dst_end)
     return 0; // FULL
@@ -385,19 +400,28 @@ static inline void lzvn_init_table(lzvn_encoder_state *state) {
     e.values[i] = value;
   }
   int u;
-  for (u = 0; u < LZVN_ENCODE_HASH_VALUES; u++)
+  int n = 1 << (state->hash_bits ? state->hash_bits : LZVN_ENCODE_HASH_BITS);
+  for (u = 0; u < n; u++)
     state->table[u] = e; // fill entire table
 }
 
-void lzvn_encode(lzvn_encoder_state *state) {
+/*! @abstract Body of lzvn_encode, with the loop bound and hash mask passed
+ * explicitly so that lzvn_encode_page gets a copy specialized for constant
+ * values. */
+LZFSE_INLINE void lzvn_encode_impl(lzvn_encoder_state *state,
+                                   lzvn_offset src_current_end,
+                                   uint32_t hash_mask) {
   const lzvn_match_info NO_MATCH = {0};
 
-  for (; state->src_current < state->src_current_end; state->src_current++) {
+  for (; state->src_current < src_current_end; state->src_current++) {
+    // Number of positions to skip after this one, without updating the table
+    lzvn_offset skip = 0;
+
     // Get 4 bytes at src_current
     uint32_t vi = load4(state->src + state->src_current);
 
     // Compute new hash H at position I, and push value into position table
-    int h = hash3i(vi); // index of first entry
+    int h = hash3i(vi, hash_mask); // index of first entry
 
     // Read table entries for H
     lzvn_encode_entry_type e = state->table[h];
@@ -463,15 +487,17 @@ void lzvn_encode(lzvn_encoder_state *state) {
     ik = offset_from_s32(e.indices[0]);
     nk = trailing_zero_bytes(diffs[0]);
     CHECK_CANDIDATE(ik, nk);
-    ik = offset_from_s32(e.indices[1]);
-    nk = trailing_zero_bytes(diffs[1]);
-    CHECK_CANDIDATE(ik, nk);
-    ik = offset_from_s32(e.indices[2]);
-    nk = trailing_zero_bytes(diffs[2]);
-    CHECK_CANDIDATE(ik, nk);
-    ik = offset_from_s32(e.indices[3]);
-    nk = trailing_zero_bytes(diffs[3]);
-    CHECK_CANDIDATE(ik, nk);
+    if (state->level != LZVN_ENCODE_LEVEL_FAST) {
+      ik = offset_from_s32(e.indices[1]);
+      nk = trailing_zero_bytes(diffs[1]);
+      CHECK_CANDIDATE(ik, nk);
+      ik = offset_from_s32(e.indices[2]);
+      nk = trailing_zero_bytes(diffs[2]);
+      CHECK_CANDIDATE(ik, nk);
+      ik = offset_from_s32(e.indices[3]);
+      nk = trailing_zero_bytes(diffs[3]);
+      CHECK_CANDIDATE(ik, nk);
+    }
 
     // Check candidate at previous distance
     if (state->d_prev != 0) {
@@ -500,6 +526,18 @@ void lzvn_encode(lzvn_encoder_state *state) {
           EMIT_LITERAL(271); // emit long literal (271 is the longest literal size we allow)
         }
       }
+      // FAST: the longer we go without a match, the faster we move ahead
+      if (state->level == LZVN_ENCODE_LEVEL_FAST)
+        skip = (state->src_current - state->src_literal) >>
+               LZVN_ENCODE_FAST_SKIP_SHIFT;
+      goto after_emit;
+    }
+
+    if (state->level == LZVN_ENCODE_LEVEL_FAST) {
+      // FAST: no pending match, emit incoming right away and resume the
+      // search after it
+      EMIT_MATCH(incoming);
+      skip = incoming.m_end - 1 - state->src_current;
       goto after_emit;
     }
 
@@ -520,8 +558,17 @@ void lzvn_encode(lzvn_encoder_state *state) {
       } else {
         // If pending is better, emit pending and discard incoming.
         // Otherwise, emit incoming and discard pending.
-        if (incoming.K > state->pending.K)
+        // HIGH: keep the better match pending instead, so it can still be
+        // replaced at the next positions, and give pending at least two
+        // positions of lookahead before emitting it.
+        if (incoming.K > state->pending.K) {
           state->pending = incoming;
+          if (state->level == LZVN_ENCODE_LEVEL_HIGH)
+            goto after_emit;
+        } else if (state->level == LZVN_ENCODE_LEVEL_HIGH &&
+                   state->src_current < state->pending.m_begin + 2) {
+          goto after_emit;
+        }
         EMIT_MATCH(state->pending);
         state->pending = NO_MATCH;
       }
@@ -532,12 +579,20 @@ void lzvn_encode(lzvn_encoder_state *state) {
     // We commit state changes only after we tried to emit instructions, so we
     // can restart in the same state in case dst was full and we quit the loop.
     state->table[h] = updated_e;
+    state->src_current += skip;
 
   } // i loop
 
   // Do not emit pending match here. We do it only at the end of stream.
 }
 
+void lzvn_encode(lzvn_encoder_state *state) {
+  int hash_bits = state->hash_bits ? state->hash_bits : LZVN_ENCODE_HASH_BITS;
+  int stage = LZFSE_STAGE_ENTER(state, LZVN_STAGE_SEARCH);
+  lzvn_encode_impl(state, state->src_current_end, (1U << hash_bits) - 1);
+  LZFSE_STAGE_LEAVE(state, stage);
+}
+
 // ===============================================================
 // API entry points
 
@@ -545,7 +600,7 @@ size_t lzvn_encode_scratch_size(void) { return LZVN_ENCODE_WORK_SIZE; }
 
 static size_t lzvn_encode_partial(void *dst, size_t dst_size,
                                   const void *src, size_t src_size,
-                                  size_t *src_used, void *work) {
+                                  size_t *src_used, void *work, int level) {
   // Min size checks to avoid accessing memory outside buffers.
   if (dst_size < LZVN_ENCODE_MIN_DST_SIZE) {
     *src_used = 0;
@@ -569,6 +624,8 @@ static size_t lzvn_encode_partial(void *dst, size_t dst_size,
   state.dst_begin = dst;
   state.dst_end = (unsigned char *)dst + dst_size - 8; // reserve 8 bytes for end-of-stream
   state.table = work;
+  state.level = level;
+  state.hash_bits = lzvn_encode_hash_bits(src_size);
 
   // Do not encode if the input buffer is too small. We'll emit a literal instead.
   if (src_size >= LZVN_ENCODE_MIN_SRC_SIZE) {
@@ -591,19 +648,60 @@ static size_t lzvn_encode_partial(void *dst, size_t dst_size,
   return (size_t)(state.dst - state.dst_begin);
 }
 
-size_t lzvn_encode_buffer(void *dst, size_t dst_size,
-                          const void *src, size_t src_size,
-                          void *work) {
+size_t lzvn_encode_buffer_level(void *dst, size_t dst_size,
+                                const void *src, size_t src_size,
+                                void *work, int level) {
   size_t src_used = 0;
   size_t dst_used =
-      lzvn_encode_partial(dst, dst_size, src, src_size, &src_used, work);
+      lzvn_encode_partial(dst, dst_size, src, src_size, &src_used, work, level);
   if (src_used != src_size)
     return 0;      // could not encode entire input stream = fail
   return dst_used; // return encoded size
 }
 
+size_t lzvn_encode_buffer(void *dst, size_t dst_size,
+                          const void *src, size_t src_size,
+                          void *work) {
+  return lzvn_encode_buffer_level(dst, dst_size, src, src_size, work,
+                                  LZVN_ENCODE_LEVEL_DEFAULT);
+}
+
+size_t lzvn_encode_page(void *dst, size_t dst_size, const void *src,
+                        void *work) {
+  if (dst_size < LZVN_ENCODE_MIN_DST_SIZE)
+    return 0;
+
+  // Same setup as lzvn_encode_partial, with constant sizes
+  lzvn_encoder_state state;
+  memset(&state, 0, sizeof(state));
+
+  state.src = src;
+  state.src_end = (lzvn_offset)LZVN_PAGE_SIZE;
+  state.src_current_end = (lzvn_offset)LZVN_PAGE_SIZE - LZVN_ENCODE_MIN_MARGIN;
+  state.dst = dst;
+  state.dst_begin = dst;
+  state.dst_end = (unsigned char *)dst + dst_size - 8; // reserve 8 bytes for end-of-stream
+  state.table = work;
+  state.hash_bits = LZVN_PAGE_HASH_BITS;
+
+  lzvn_init_table(&state);
+  int stage = LZFSE_STAGE_ENTER(&state, LZVN_STAGE_SEARCH);
+  lzvn_encode_impl(&state, (lzvn_offset)LZVN_PAGE_SIZE - LZVN_ENCODE_MIN_MARGIN,
+                   (1U << LZVN_PAGE_HASH_BITS) - 1);
+  LZFSE_STAGE_LEAVE(&state, stage);
+  lzvn_emit_literal(&state, state.src_end - state.src_literal);
+  if (state.src_literal != (lzvn_offset)LZVN_PAGE_SIZE)
+    return 0; // DST full
+
+  state.dst_end = (unsigned char *)dst + dst_size;
+  lzvn_emit_end_of_stream(&state);
+  return (size_t)(state.dst - state.dst_begin);
+}
+
 EXPORT_SYMBOL(lzvn_encode_scratch_size);
 EXPORT_SYMBOL(lzvn_encode_buffer);
+EXPORT_SYMBOL(lzvn_encode_buffer_level);
+EXPORT_SYMBOL(lzvn_encode_page);
 EXPORT_SYMBOL(lzvn_encode);
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("Lzvn Compressor");